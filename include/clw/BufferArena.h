@@ -0,0 +1,108 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace clw
+{
+    enum class EArenaMode
+    {
+        // Bump allocation, memory is reclaimed only with reset() 
+        // (e.g. per-frame transient data)
+        Linear,
+        // First-fit allocation with coalescing free list (long-lived data)
+        FreeList
+    };
+
+    // Carves sub-buffers out of one big buffer so many small allocations 
+    // cost a single driver allocation. Offsets are aligned to the strictest
+    // CL_DEVICE_MEM_BASE_ADDR_ALIGN (and minimum data type alignment) of 
+    // all context's devices. Requires +OpenCL 1.1. All methods are thread-safe.
+    class CLW_EXPORT BufferArena
+    {
+    public:
+        BufferArena();
+        BufferArena(Context* context, 
+                    EAccess access, 
+                    EMemoryLocation location,
+                    size_t capacity,
+                    EArenaMode mode = EArenaMode::FreeList);
+
+        // Drops previous buffer (and all allocations) if any
+        bool create(Context* context, 
+                    EAccess access, 
+                    EMemoryLocation location,
+                    size_t capacity,
+                    EArenaMode mode = EArenaMode::FreeList);
+
+        bool isNull() const;
+        const Buffer& buffer() const { return _buffer; }
+        EArenaMode mode() const { return _mode; }
+        size_t capacity() const { return _capacity; }
+        size_t alignment() const { return _alignment; }
+
+        // Returns null buffer if there's no room left
+        Buffer allocate(size_t size);
+        Buffer allocate(size_t size, EAccess access);
+        // Only meaningful in FreeList mode, where it's mandatory - block of
+        // a sub-buffer dropped without free() stays allocated until reset().
+        // Sub-buffers not carved from this arena are ignored
+        void free(const Buffer& subBuffer);
+        // Forgets all allocations, sub-buffers still in use must not be 
+        // accessed afterwards
+        void reset();
+
+        size_t usedBytes() const;
+        size_t numAllocations() const;
+        size_t largestFreeBlock() const;
+
+    private:
+        size_t alignUp(size_t value) const
+        {
+            return (value + _alignment - 1) / _alignment * _alignment;
+        }
+
+    private:
+        typedef std::pair<size_t, size_t> Block;
+
+        Buffer _buffer;
+        EAccess _access;
+        EArenaMode _mode;
+        size_t _capacity;
+        size_t _alignment;
+        mutable std::mutex _mutex;
+        // Linear mode
+        size_t _top;
+        // FreeList mode: offset -> size
+        std::map<size_t, size_t> _freeBlocks;
+        // Allocated blocks (offset, size) by sub-buffer
+        std::unordered_map<cl_mem, Block> _allocations;
+        size_t _used;
+    };
+}
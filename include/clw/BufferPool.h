@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <memory>
+
+namespace clw
+{
+    namespace detail
+    {
+        struct OutstandingBuffers;
+    }
+
+    struct BufferPoolStatistics
+    {
+        BufferPoolStatistics()
+            : hits(0)
+            , misses(0)
+            , evictions(0)
+            , outstandingBuffers(0)
+            , outstandingBytes(0)
+            , idleBuffers(0)
+            , idleBytes(0)
+        {}
+
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t outstandingBuffers;
+        uint64_t outstandingBytes;
+        uint64_t idleBuffers;
+        uint64_t idleBytes;
+    };
+
+    // Recycles device buffers so hot paths don't pay for clCreateBuffer and
+    // clReleaseMemObject. Buffers are grouped by size class (powers of two
+    // split into quarters), access and memory location. Byte budget limits
+    // total size of idle buffers, least recently returned ones are released
+    // first. UseHostMemory buffers can't be pooled. All methods are thread-safe.
+    class CLW_EXPORT BufferPool
+    {
+    public:
+        explicit BufferPool(Context* context = nullptr,
+                            uint64_t budget = 256 * 1024 * 1024);
+
+        Context* context() const { return _ctx; }
+        // Releases all idle buffers from previous context
+        void setContext(Context* context);
+
+        // Returned buffer is at least (not exactly) size bytes big 
+        // and its contents are undefined
+        Buffer acquire(EAccess access, EMemoryLocation location, size_t size);
+        // Gives buffer back to the pool. Buffers not acquired from 
+        // this pool are simply dropped. Caller must not use other copies
+        // of the buffer (nor have pending commands using it) afterwards
+        void release(Buffer buffer);
+
+        uint64_t budget() const;
+        void setBudget(uint64_t budget);
+        // Releases least recently used idle buffers until no more than 
+        // maxIdleBytes remain
+        void trim(uint64_t maxIdleBytes = 0);
+
+        BufferPoolStatistics statistics() const;
+        void resetStatistics();
+
+        static size_t sizeClass(size_t size);
+
+    private:
+        typedef std::tuple<size_t, EAccess, EMemoryLocation> Key;
+
+        struct IdleBuffer
+        {
+            Key key;
+            Buffer buffer;
+        };
+        typedef std::list<IdleBuffer> IdleList;
+
+        void trimLocked(uint64_t maxIdleBytes);
+        void removeIdle(IdleList::iterator it);
+
+    private:
+        Context* _ctx;
+        uint64_t _budget;
+        mutable std::mutex _mutex;
+        // Most recently returned at front
+        IdleList _idle;
+        std::multimap<Key, IdleList::iterator> _idleByKey;
+        // Shared with destructor callbacks of created buffers, which drop
+        // entries of buffers destroyed without being released
+        std::shared_ptr<detail::OutstandingBuffers> _outstanding;
+        BufferPoolStatistics _stats;
+    };
+}
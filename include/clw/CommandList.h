@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+#include "clw/Kernel.h"
+
+namespace clw
+{
+    namespace detail
+    {
+        struct CommandBufferFunctions;
+    }
+
+    // Sequence of commands recorded once and replayed many times with a 
+    // single call. Uses cl_khr_command_buffer (0.9.5 or newer) when queue's
+    // device supports it and queue is in-order, otherwise replays recorded
+    // commands one by one. Either way commands run in the order they were
+    // recorded and kernel arguments and work sizes are captured at the 
+    // time of recording. Memory objects used must outlive the list.
+    class CLW_EXPORT CommandList
+    {
+    public:
+        CommandList();
+        explicit CommandList(const CommandQueue& queue, bool allowNative = true);
+        ~CommandList();
+
+        bool create(const CommandQueue& queue, bool allowNative = true);
+        void release();
+
+        bool isNull() const { return _queue.isNull(); }
+        // True if backed by cl_khr_command_buffer
+        bool isNative() const { return _native != nullptr; }
+        bool isFinalized() const { return _finalized; }
+        size_t size() const { return _size; }
+        const CommandQueue& commandQueue() const { return _queue; }
+
+        bool recordKernel(const Kernel& kernel);
+        bool recordCopyBuffer(const Buffer& src,
+                              size_t srcOffset,
+                              const Buffer& dst,
+                              size_t dstOffset,
+                              size_t size);
+        bool recordCopyBuffer(const Buffer& src,
+                              const Buffer& dst);
+        // Requires +OpenCL 1.2
+        bool recordFillBuffer(const Buffer& buffer,
+                              const void* pattern,
+                              size_t patternSize,
+                              size_t offset,
+                              size_t size);
+
+        // Ends recording, called by first replay() if not done explicitly
+        bool finalize();
+        // Enqueues all recorded commands, returned event completes with 
+        // the last one
+        Event replay(const EventList& after = EventList());
+
+    private:
+        // Host-side recorded command (fallback)
+        struct Command
+        {
+            ECommandType type;
+            Kernel kernel;
+            KernelArgumentValues arguments;
+            Buffer src;
+            Buffer dst;
+            size_t srcOffset;
+            size_t dstOffset;
+            size_t size;
+            vector<unsigned char> pattern;
+        };
+
+    private:
+        CommandList(const CommandList&);
+        CommandList& operator=(const CommandList&);
+
+        CommandQueue _queue;
+        const detail::CommandBufferFunctions* _native;
+        // cl_command_buffer_khr
+        void* _buffer;
+        // Sync point of last recorded native command
+        cl_uint _lastSyncPoint;
+        vector<Command> _commands;
+        size_t _size;
+        bool _finalized;
+    };
+
+    inline bool CommandList::recordCopyBuffer(const Buffer& src,
+                                              const Buffer& dst)
+    {
+        return recordCopyBuffer(src, 0, dst, 0, src.size());
+    }
+}
@@ -28,6 +28,8 @@
 #include "clw/Buffer.h"
 #include "clw/EnumFlags.h"
 
+#include <memory>
+
 namespace clw
 {
     enum class ECommandQueueProperty
@@ -48,6 +50,11 @@ namespace clw
     typedef EnumFlags<EMapAccess> MapAccessFlags;
     CLW_DEFINE_ENUMFLAGS_OPERATORS(MapAccessFlags)
 
+    namespace detail
+    {
+        class HazardTracker;
+    }
+
     class CLW_EXPORT CommandQueue
     {
     public:
@@ -63,9 +70,21 @@ namespace clw
         CommandQueue& operator=(CommandQueue&& other);
 
         bool isNull() const { return _id == 0; }
+        Device device() const;
         bool isProfilingEnabled() const;
         bool isOutOfOrder() const;
 
+        // Records last writer and outstanding readers of every memory object
+        // used by commands enqueued with this queue (and copies made after 
+        // enabling it). Each command then also waits for unfinished commands
+        // it conflicts with, so out-of-order queue can be used without 
+        // wiring events by hand. Sub-buffers are checked against their 
+        // parent and other overlapping sub-buffers. Kernel accesses are taken
+        // from memory object arguments (see Kernel::boundMemoryObjects()) - 
+        // ones set through raw setArg(index, data, size) aren't tracked.
+        void setHazardTracking(bool enabled);
+        bool isHazardTrackingEnabled() const { return _tracker != nullptr; }
+
         void finish();
         void flush();
 
@@ -261,8 +280,15 @@ namespace clw
                          void* ptr,
                          const EventList& after = EventList());
 
+        // Requires +OpenCL 1.2, cause error if used otherwise
+        Event asyncFillBuffer(Buffer& buffer,
+                              const void* pattern,
+                              size_t patternSize,
+                              size_t offset,
+                              size_t size,
+                              const EventList& after = EventList());
+
         // !TODO OpenCL 1.2
-        // clEnqueueFillBuffer
         // clEnqueueFillImage
 
         bool runKernel(const Kernel& kernel);
@@ -276,16 +302,34 @@ namespace clw
         //bool runNativeKernel();
         //Event asyncRunNativeKernel();
 
+        // Completes when all given events (or, if none given, all previously
+        // enqueued commands) complete. Before OpenCL 1.2 waits for the events
+        // with clEnqueueWaitForEvents first
+        Event asyncMarker(const EventList& after = EventList());
+
         // !TODO OpenCL 1.2
         // clEnqueueMigrateMemObjects
-        // clEnqueueMarkerWithWaitList
 
         cl_command_queue commandQueueId() const { return _id; }
         Context* context() const { return _ctx; }
 
     private:
         Context* _ctx;
-        cl_command_queue _id;		
+        cl_command_queue _id;
+        std::shared_ptr<detail::HazardTracker> _tracker;
+
+        void appendHazards(EventList& list, 
+                           const vector<cl_mem>& reads, 
+                           const vector<cl_mem>& writes) const;
+        void appendHazards(EventList& list, cl_mem read, cl_mem write) const;
+        // Returns after or, if tracking is enabled, deps filled with after 
+        // and the hazards
+        const EventList& waitList(const EventList& after, EventList& deps,
+                                  cl_mem read, cl_mem write) const;
+        Event track(cl_event event, 
+                    const vector<cl_mem>& reads, 
+                    const vector<cl_mem>& writes);
+        Event track(cl_event event, cl_mem read, cl_mem write);
     };
 
     inline bool CommandQueue::readBuffer(const Buffer& buffer,
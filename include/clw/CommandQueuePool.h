@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/CommandQueue.h"
+#include "clw/Device.h"
+#include "clw/Event.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace clw
+{
+    enum class EQueueAssignment
+    {
+        // Each call gets next queue of the device
+        RoundRobin,
+        // Calling thread always gets the same queue of the device
+        PerThread
+    };
+
+    typedef function<Event(CommandQueue& queue)> QueueCommand;
+
+    // Owns several command queues per device of a context so work coming 
+    // from many threads can execute concurrently (kernels on different 
+    // queues, copies overlapping compute). All methods are thread-safe.
+    class CLW_EXPORT CommandQueuePool
+    {
+    public:
+        CommandQueuePool();
+        explicit CommandQueuePool(Context& context,
+                                  size_t queuesPerDevice = 2,
+                                  size_t maxInFlight = 16,
+                                  EQueueAssignment assignment = EQueueAssignment::RoundRobin,
+                                  CommandQueueFlags properties = CommandQueueFlags());
+
+        bool create(Context& context,
+                    size_t queuesPerDevice = 2,
+                    size_t maxInFlight = 16,
+                    EQueueAssignment assignment = EQueueAssignment::RoundRobin,
+                    CommandQueueFlags properties = CommandQueueFlags());
+
+        bool isNull() const { return _devices.empty(); }
+        size_t numDevices() const { return _devices.size(); }
+        size_t queuesPerDevice() const { return _queuesPerDevice; }
+        size_t maximumInFlight() const { return _maxInFlight; }
+
+        // Queue picked for the device (first one of the context if null) 
+        // according to assignment policy. Commands enqueued directly on it
+        // don't count towards in-flight limit. Null queue (and 
+        // CL_INVALID_DEVICE) for device not belonging to the context
+        CommandQueue acquire(const Device& device = Device());
+
+        // Calls command with queue picked as in acquire(), first waiting 
+        // until that queue has less than maximumInFlight() unfinished 
+        // commands submitted this way. Returned event is command's one
+        Event submit(const QueueCommand& command,
+                     const Device& device = Device());
+
+        void flush();
+        void finish();
+
+    private:
+        struct Slot
+        {
+            std::mutex mutex;
+            CommandQueue queue;
+            // Submitted commands that weren't seen finished yet
+            std::deque<Event> inFlight;
+        };
+
+        struct DeviceQueues
+        {
+            DeviceQueues() : next(0) {}
+
+            Device device;
+            vector<std::unique_ptr<Slot>> slots;
+            std::atomic<size_t> next;
+        };
+
+        Slot* pick(const Device& device);
+
+    private:
+        CommandQueuePool(const CommandQueuePool&);
+        CommandQueuePool& operator=(const CommandQueuePool&);
+
+        vector<std::unique_ptr<DeviceQueues>> _devices;
+        size_t _queuesPerDevice;
+        size_t _maxInFlight;
+        EQueueAssignment _assignment;
+    };
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace clw
+{
+    namespace detail
+    {
+        template <typename T> class BoundedQueue;
+    }
+
+    typedef function<void(CommandQueue& queue)> SubmitterCommand;
+
+    // Front-end letting many threads enqueue onto one command queue 
+    // without contending on it: commands are handed over through a 
+    // lock-free bounded queue and enqueued by a dedicated submitter thread,
+    // which sleeps when there's nothing to do. Commands run in the order 
+    // they were posted (per producer). Errors they cause are reported 
+    // through error handler and recorded as submitter thread's last error
+    // (exceptions escaping a command as CL_INVALID_OPERATION).
+    class CLW_EXPORT CommandSubmitter
+    {
+    public:
+        CommandSubmitter();
+        explicit CommandSubmitter(const CommandQueue& queue, 
+                                  size_t capacity = 1024);
+        // Enqueues remaining commands first
+        ~CommandSubmitter();
+
+        bool start(const CommandQueue& queue, size_t capacity = 1024);
+        // Enqueues remaining commands, flushes the queue and joins thread
+        void stop();
+
+        // Safe to call from producer threads
+        bool isRunning() const { return _running; }
+        const CommandQueue& commandQueue() const { return _queue; }
+
+        // Returns false if submission queue is full or submitter is stopped
+        bool tryPost(SubmitterCommand command);
+        // Yields while submission queue is full. Returns false (and drops
+        // the command) if submitter is stopped
+        bool post(SubmitterCommand command);
+        // Result holds event returned by command once it's enqueued, or 
+        // exception it has thrown. Null event if submitter is stopped
+        std::future<Event> submit(function<Event(CommandQueue& queue)> command);
+
+        // Blocks until all commands posted so far are enqueued and flushed
+        void drain();
+
+    private:
+        void run();
+        void wake();
+
+    private:
+        CommandSubmitter(const CommandSubmitter&);
+        CommandSubmitter& operator=(const CommandSubmitter&);
+
+        CommandQueue _queue;
+        std::unique_ptr<detail::BoundedQueue<SubmitterCommand>> _commands;
+        std::thread _thread;
+        std::atomic<uint64_t> _posted;
+        std::atomic<uint64_t> _processed;
+        // Producers between their check of _stopping and finished push
+        std::atomic<size_t> _posting;
+        std::atomic<bool> _sleeping;
+        std::atomic<bool> _stopping;
+        // std::thread::joinable() races with start()/stop()
+        std::atomic<bool> _running;
+        std::mutex _mutex;
+        std::condition_variable _wakeup;
+        std::condition_variable _drained;
+    };
+}
@@ -0,0 +1,101 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Event.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace clw
+{
+    namespace detail
+    {
+        template <typename T> class BoundedQueue;
+        struct CompletionNode;
+        void deliverCompletion(CompletionNode* node);
+    }
+
+    // Status is Complete or (negative) Errored
+    typedef function<void(const Event& event, EEventStatus status)> CompletionHandler;
+
+    // Completion port for events: driver's callback thread only pushes 
+    // finished event onto a bounded lock-free queue, handlers run on a 
+    // small pool of worker threads. Lets a few threads serve any number 
+    // of in-flight commands without blocking one thread per wait.
+    class CLW_EXPORT CompletionQueue
+    {
+    public:
+        CompletionQueue();
+        explicit CompletionQueue(size_t numWorkers, size_t capacity = 4096);
+        // Waits for all watched events first
+        ~CompletionQueue();
+
+        bool start(size_t numWorkers, size_t capacity = 4096);
+        // Waits for all watched events and their handlers, joins workers.
+        // Can't be called from a handler (reports CL_INVALID_OPERATION)
+        void stop();
+
+        bool isRunning() const { return !_workers.empty(); }
+        size_t numWorkers() const { return _workers.size(); }
+        // Watched events whose handlers haven't finished yet
+        size_t pending() const { return _pending; }
+
+        // Calls handler on one of the workers once event completes. 
+        // Exception escaping the handler is reported as CL_INVALID_OPERATION
+        bool watch(const Event& event, CompletionHandler handler);
+        // Blocks until pending() drops to zero. Like stop(), can't be called
+        // from a handler as pending() includes the running handler itself
+        void waitForIdle();
+
+    private:
+        friend void detail::deliverCompletion(detail::CompletionNode* node);
+
+        void push(detail::CompletionNode* node);
+        void work();
+        detail::CompletionNode* next();
+        bool isWorkerThread() const;
+
+    private:
+        CompletionQueue(const CompletionQueue&);
+        CompletionQueue& operator=(const CompletionQueue&);
+
+        std::unique_ptr<detail::BoundedQueue<detail::CompletionNode*>> _ready;
+        // Completions that didn't fit into the queue
+        std::deque<detail::CompletionNode*> _overflow;
+        std::atomic<size_t> _overflowSize;
+        std::atomic<size_t> _readyCount;
+        std::atomic<size_t> _pending;
+        std::atomic<size_t> _sleeping;
+        std::atomic<bool> _stopping;
+        vector<std::thread> _workers;
+        std::mutex _mutex;
+        std::condition_variable _wakeup;
+        std::condition_variable _idle;
+    };
+}
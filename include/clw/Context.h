@@ -28,6 +28,7 @@
 #include "clw/Sampler.h"
 #include "clw/MemoryObject.h"
 #include "clw/CommandQueue.h"
+#include "clw/Program.h"
 
 namespace clw
 {
@@ -50,8 +51,12 @@ namespace clw
         void release();
         bool isCreated() const { return _isCreated; }
 
-        cl_int lastError() const { return _eid; }
-        void setLastError(cl_int error) { _eid = error; }
+        // Same as clw::lastError()/clw::setLastError(), kept for 
+        // compatibility. Note these used to be per-context and are now 
+        // static and per-thread: error set by one context is seen through
+        // every other one on the same thread, but not on other threads
+        static cl_int lastError();
+        static void setLastError(cl_int error);
 
         CommandQueue createCommandQueue(const Device& device,
                                         CommandQueueFlags properties = CommandQueueFlags());
@@ -89,15 +94,53 @@ namespace clw
         Program buildProgramFromSourceFile(const string& fileName, 
                                            const string& options = string());
 
-        // !TODO: createProgramFromBinaries()
+        // Links compiled objects and libraries into an executable (or, with
+        // -create-library option, a library) program (OpenCL 1.2)
+        Program linkPrograms(const vector<Program>& programs,
+                             const string& options = string());
+
+        // When set, buildProgramFromSource* look up and store program 
+        // binaries in the given cache. Cache must outlive the context
+        void setProgramCache(ProgramCache* cache) { _programCache = cache; }
+        ProgramCache* programCache() const { return _programCache; }
+
+        // Binaries are matched with devices by their position
+        Program createProgramFromBinaries(const vector<Device>& devices,
+                                          const vector<ByteCode>& binaries);
+        Program createProgramFromBinary(const Device& device,
+                                        const ByteCode& binary);
+
+        // Builds program from bundled binaries if there's one for every 
+        // device in the context. Otherwise (or if build from binaries fails)
+        // falls back to given source code (if not empty)
+        Program buildProgramFromBundle(const ProgramBundle& bundle,
+                                       const string& fallbackSourceCode = string());
+        Program buildProgramFromBundleFile(const string& fileName,
+                                           const string& fallbackSourceFile = string());
 
     private:
         cl_context _id;
         bool _isCreated;
-        cl_int _eid;
         vector<Device> _devs;
+        ProgramCache* _programCache;
     };
 
     typedef function<void(int errId, const string& message)> ErrorHandler;
     void CLW_EXPORT installErrorHandler(const ErrorHandler& handler);
+
+    // Error code of the last failed call made by the calling thread (or 
+    // of the last Context call, successful or not). Each thread has its own
+    // so threads using the same objects don't race on it
+    cl_int CLW_EXPORT lastError();
+    void CLW_EXPORT setLastError(cl_int error);
+
+    inline cl_int Context::lastError()
+    {
+        return clw::lastError();
+    }
+
+    inline void Context::setLastError(cl_int error)
+    {
+        clw::setLastError(error);
+    }
 }
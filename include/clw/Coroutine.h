@@ -0,0 +1,339 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+// Opt-in, requires C++20 coroutines. Not included by clw.h
+#if !defined(__cpp_impl_coroutine)
+#  error "clw/Coroutine.h requires C++20 coroutines"
+#endif
+
+#include "clw/Prerequisites.h"
+#include "clw/CompletionQueue.h"
+#include "clw/Event.h"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+namespace clw
+{
+    // Executor resuming coroutine right on driver's callback thread. Code
+    // running there until the next suspension point must not make blocking
+    // OpenCL calls (waits, blocking transfers, clFinish) - it stalls or 
+    // deadlocks driver's callback dispatch. There's no implicit inline 
+    // co_await for this reason, it has to be asked for explicitly
+    struct InlineResume
+    {
+        void operator()(std::coroutine_handle<> handle) const { handle.resume(); }
+    };
+
+    namespace detail
+    {
+        inline EEventStatus finishedStatus(EEventStatus status)
+        {
+            return cl_int(status) < 0 ? EEventStatus::Errored : status;
+        }
+
+        // Callback would never fire for commands stuck in unflushed queue
+        inline void flushEventQueue(const Event& event)
+        {
+            cl_command_queue queue = nullptr;
+            if(clGetEventInfo(event.eventId(), CL_EVENT_COMMAND_QUEUE, 
+                    sizeof(cl_command_queue), &queue, nullptr) == CL_SUCCESS && queue)
+                clFlush(queue);
+        }
+
+        template <typename Executor>
+        class EventAwaiter
+        {
+        public:
+            EventAwaiter(const Event& event, Executor executor)
+                : _event(event)
+                , _executor(std::move(executor))
+                , _status(EEventStatus::Errored)
+            {
+            }
+
+            bool await_ready()
+            {
+                if(_event.isNull())
+                    return true;
+                _status = finishedStatus(_event.status());
+                return cl_int(_status) <= 0;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                flushEventQueue(_event);
+                EventAwaiter* self = this;
+                // Awaiter may be gone right after resume, don't touch it past that
+                if(_event.setCallback(EEventStatus::Complete, 
+                    [self, handle](EEventStatus status)
+                    {
+                        self->_status = finishedStatus(status);
+                        Executor executor(std::move(self->_executor));
+                        executor(handle);
+                    }))
+                    return true;
+                // Callable was destroyed uncalled - carry on immediately
+                _status = EEventStatus::Errored;
+                return false;
+            }
+
+            EEventStatus await_resume() const { return _status; }
+
+        private:
+            Event _event;
+            Executor _executor;
+            EEventStatus _status;
+        };
+
+        class CompletionQueueAwaiter
+        {
+        public:
+            CompletionQueueAwaiter(const Event& event, CompletionQueue& queue)
+                : _event(event)
+                , _queue(queue)
+                , _status(EEventStatus::Errored)
+            {
+            }
+
+            bool await_ready()
+            {
+                if(_event.isNull())
+                    return true;
+                _status = finishedStatus(_event.status());
+                return cl_int(_status) <= 0;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                flushEventQueue(_event);
+                CompletionQueueAwaiter* self = this;
+                _status = EEventStatus::Errored;
+                // Not running queue - carry on immediately with Errored
+                return _queue.watch(_event, 
+                    [self, handle](const Event&, EEventStatus status)
+                    {
+                        self->_status = finishedStatus(status);
+                        handle.resume();
+                    });
+            }
+
+            EEventStatus await_resume() const { return _status; }
+
+        private:
+            Event _event;
+            CompletionQueue& _queue;
+            EEventStatus _status;
+        };
+
+        template <typename Executor>
+        class AllOfAwaiter
+        {
+        public:
+            AllOfAwaiter(const EventList& events, Executor executor)
+                : _events(events)
+                , _state(std::make_shared<State>(std::move(executor)))
+            {
+            }
+
+            bool await_ready() const { return _events.isEmpty(); }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                // Coroutine may be resumed (and awaiter destroyed) before
+                // registration loop ends, so it iterates over a local copy
+                EventList events(_events);
+                std::shared_ptr<State> state = _state;
+                // One extra count is held by this function - if all events
+                // have finished (or failed to register) by the time it's 
+                // dropped, coroutine carries on right away
+                state->remaining = events.size() + 1;
+                for(size_t i = 0; i < events.size(); ++i)
+                    flushEventQueue(events.at(i));
+                for(size_t i = 0; i < events.size(); ++i)
+                {
+                    if(!events.at(i).setCallback(EEventStatus::Complete, 
+                            [state, handle](EEventStatus status) 
+                            { 
+                                state->finished(status, handle); 
+                            }))
+                        state->finished(EEventStatus::Errored, handle);
+                }
+                return --state->remaining != 0;
+            }
+
+            EEventStatus await_resume() const 
+            { 
+                return _state->failed ? EEventStatus::Errored : EEventStatus::Complete;
+            }
+
+        private:
+            struct State
+            {
+                explicit State(Executor executor)
+                    : executor(std::move(executor))
+                    , remaining(0)
+                    , failed(false)
+                {
+                }
+
+                void finished(EEventStatus status, std::coroutine_handle<> handle)
+                {
+                    if(finishedStatus(status) != EEventStatus::Complete)
+                        failed = true;
+                    if(--remaining == 0)
+                    {
+                        Executor resume(std::move(executor));
+                        resume(handle);
+                    }
+                }
+
+                Executor executor;
+                std::atomic<size_t> remaining;
+                std::atomic<bool> failed;
+            };
+
+            EventList _events;
+            std::shared_ptr<State> _state;
+        };
+
+        template <typename Executor>
+        class AnyOfAwaiter
+        {
+        public:
+            AnyOfAwaiter(const EventList& events, Executor executor)
+                : _events(events)
+                , _state(std::make_shared<State>(std::move(executor)))
+            {
+            }
+
+            bool await_ready() const { return _events.isEmpty(); }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                EventList events(_events);
+                for(size_t i = 0; i < events.size(); ++i)
+                    flushEventQueue(events.at(i));
+                // Callbacks of the events that lost the race only see the state
+                std::shared_ptr<State> state = _state;
+                for(size_t i = 0; i < events.size(); ++i)
+                {
+                    if(events.at(i).setCallback(EEventStatus::Complete, 
+                        [state, handle, i](EEventStatus)
+                        {
+                            if(state->fired.exchange(true))
+                                return;
+                            state->index = i;
+                            Executor executor(std::move(state->executor));
+                            executor(handle);
+                        }))
+                        continue;
+                    // Event that couldn't be watched counts as finished 
+                    // (unless another one has already won)
+                    if(state->fired.exchange(true))
+                        return true;
+                    state->index = i;
+                    return false;
+                }
+                return true;
+            }
+
+            // Index of first finished event (0 for an empty list)
+            size_t await_resume() const { return _state->index; }
+
+        private:
+            struct State
+            {
+                explicit State(Executor executor)
+                    : executor(std::move(executor))
+                    , fired(false)
+                    , index(0)
+                {
+                }
+
+                Executor executor;
+                std::atomic<bool> fired;
+                size_t index;
+            };
+
+            EventList _events;
+            std::shared_ptr<State> _state;
+        };
+    }
+
+    // co_await resumeOn(event, executor) - yields final status (Complete 
+    // or Errored), null event yields Errored at once. Executor is any 
+    // callable taking std::coroutine_handle<> that eventually resumes it 
+    // (e.g. posts it to a thread pool)
+    template <typename Executor>
+    detail::EventAwaiter<Executor> resumeOn(const Event& event, Executor executor)
+    {
+        return detail::EventAwaiter<Executor>(event, std::move(executor));
+    }
+
+    // Resumes on one of completion queue's workers
+    inline detail::CompletionQueueAwaiter resumeOn(const Event& event, CompletionQueue& queue)
+    {
+        return detail::CompletionQueueAwaiter(event, queue);
+    }
+
+    // Resumes on driver's callback thread, see InlineResume for restrictions
+    inline detail::EventAwaiter<InlineResume> resumeInline(const Event& event)
+    {
+        return detail::EventAwaiter<InlineResume>(event, InlineResume());
+    }
+
+    // co_await allOf(events, executor) - waits for all of them, Errored if
+    // any failed
+    template <typename Executor>
+    detail::AllOfAwaiter<Executor> allOf(const EventList& events, Executor executor)
+    {
+        return detail::AllOfAwaiter<Executor>(events, std::move(executor));
+    }
+
+    // co_await anyOf(events, executor) - yields index of the first 
+    // finished event
+    template <typename Executor>
+    detail::AnyOfAwaiter<Executor> anyOf(const EventList& events, Executor executor)
+    {
+        return detail::AnyOfAwaiter<Executor>(events, std::move(executor));
+    }
+
+    // Fire-and-forget coroutine: starts eagerly and frees its frame when
+    // done. Unhandled exceptions terminate
+    struct DeviceJob
+    {
+        struct promise_type
+        {
+            DeviceJob get_return_object() { return DeviceJob(); }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+}
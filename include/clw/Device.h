@@ -62,11 +62,33 @@ namespace clw
     typedef EnumFlags<EFloatCaps> FloatCapsFlags;
     CLW_DEFINE_ENUMFLAGS_OPERATORS(FloatCapsFlags)
 
+    enum class EAffinityDomain
+    {
+        Numa              = (1 << 0),
+        L4Cache           = (1 << 1),
+        L3Cache           = (1 << 2),
+        L2Cache           = (1 << 3),
+        L1Cache           = (1 << 4),
+        NextPartitionable = (1 << 5)
+    };
+
+    namespace detail
+    {
+        vector<Device> createSubDevices(cl_device_id id, const intptr_t* props);
+    }
+
     class CLW_EXPORT Device
     {
     public:
-        Device() : _id(0) {}
-        Device(cl_device_id id) : _id(id) {}
+        Device() : _id(0), _owned(false) {}
+        Device(cl_device_id id) : _id(id), _owned(false) {}
+        ~Device();
+
+        Device(const Device& other);
+        Device& operator=(const Device& other);
+
+        Device(Device&& other);
+        Device& operator=(Device&& other);
 
         bool isNull() const { return _id == 0; }
         EDeviceType deviceType() const;
@@ -166,9 +188,25 @@ namespace clw
 
         cl_device_id deviceId() const { return _id; }
 
-        //! TODO: Device fission (OpenCL 1.2 or 1.1 with extensions)
+        // Device fission (OpenCL 1.2). Returned sub-devices are released 
+        // with their last copy and can be used to create contexts and 
+        // queues like any other device. Empty if partitioning fails
+        vector<Device> partitionEqually(int computeUnitsPerDevice) const;
+        vector<Device> partitionByCounts(const vector<int>& computeUnits) const;
+        vector<Device> partitionByAffinityDomain(
+            EAffinityDomain domain = EAffinityDomain::NextPartitionable) const;
+
+        bool isSubDevice() const;
+        // Null for root devices
+        Device parentDevice() const;
+        int maximumSubDevices() const;
+
     private:
         cl_device_id _id;
+        // Sub-devices we created hold a reference
+        bool _owned;
+
+        friend vector<Device> detail::createSubDevices(cl_device_id, const intptr_t*);
     };
 
     CLW_EXPORT vector<Device> allDevices();
@@ -24,6 +24,12 @@
 
 #include "clw/Prerequisites.h"
 
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace clw
 {
     enum class EEventStatus
@@ -68,6 +74,82 @@ namespace clw
 
     typedef function<void(EEventStatus status)> EventCallback;
 
+    namespace detail
+    {
+        // Holds callable registered with clSetEventCallback. Nodes come 
+        // from a pool and go back there once the callback has run, so 
+        // their lifetime is tied to cl_event instead of Event wrapper.
+        struct EventCallbackNode
+        {
+            static const size_t inlineSize = 6 * sizeof(void*);
+
+            // Calls stored callable (unless status is null) and destroys it,
+            // also when it throws
+            void (*invoke)(EventCallbackNode* node, const EEventStatus* status);
+            typename std::aligned_storage<inlineSize>::type storage;
+        };
+
+        EventCallbackNode* CLW_EXPORT acquireCallbackNode();
+        void CLW_EXPORT releaseCallbackNode(EventCallbackNode* node);
+        // Destroys callable and releases node (returning false) if callback
+        // can't be registered
+        bool CLW_EXPORT attachCallbackNode(cl_event id, cl_int status, 
+                                           EventCallbackNode* node);
+
+        // Callables that don't fit inline are kept on the heap
+        template <typename Callable, 
+                  bool Inline = (sizeof(Callable) <= EventCallbackNode::inlineSize &&
+                      std::alignment_of<Callable>::value <= 
+                      std::alignment_of<std::aligned_storage<
+                          EventCallbackNode::inlineSize>::type>::value)>
+        struct EventCallbackStorage
+        {
+            template <typename F>
+            static void construct(EventCallbackNode* node, F&& f)
+            {
+                new (&node->storage) Callable(std::forward<F>(f));
+                node->invoke = &invoke;
+            }
+
+            static void invoke(EventCallbackNode* node, const EEventStatus* status)
+            {
+                Callable* callable = reinterpret_cast<Callable*>(&node->storage);
+                if(status)
+                {
+                    try
+                    {
+                        (*callable)(*status);
+                    }
+                    catch(...)
+                    {
+                        callable->~Callable();
+                        throw;
+                    }
+                }
+                callable->~Callable();
+            }
+        };
+
+        template <typename Callable>
+        struct EventCallbackStorage<Callable, false>
+        {
+            template <typename F>
+            static void construct(EventCallbackNode* node, F&& f)
+            {
+                new (&node->storage) Callable*(new Callable(std::forward<F>(f)));
+                node->invoke = &invoke;
+            }
+
+            static void invoke(EventCallbackNode* node, const EEventStatus* status)
+            {
+                std::unique_ptr<Callable> callable(
+                    *reinterpret_cast<Callable**>(&node->storage));
+                if(status)
+                    (*callable)(*status);
+            }
+        };
+    }
+
     class CLW_EXPORT Event
     {
     public:
@@ -88,7 +170,13 @@ namespace clw
         EEventStatus status() const;
         ECommandType commandType() const;
 
-        void setCallback(EEventStatus status, EventCallback cb);
+        // Callable (taking EEventStatus) is called from driver's thread 
+        // once command reaches given status (or fails). Event object itself
+        // may be gone by then. Small callables don't allocate. Returns 
+        // false (callable is destroyed uncalled) if it couldn't be set.
+        // Exception escaping callable is reported as CL_INVALID_OPERATION
+        template <typename F>
+        bool setCallback(EEventStatus status, F&& callback);
         void waitForFinished();
 
         uint64_t queueTime() const;
@@ -98,9 +186,25 @@ namespace clw
 
     protected:
         cl_event _id;
-        EventCallback _callback;
     };
 
+    template <typename F>
+    bool Event::setCallback(EEventStatus status, F&& callback)
+    {
+        typedef typename std::decay<F>::type Callable;
+        detail::EventCallbackNode* node = detail::acquireCallbackNode();
+        try
+        {
+            detail::EventCallbackStorage<Callable>::construct(node, std::forward<F>(callback));
+        }
+        catch(...)
+        {
+            detail::releaseCallbackNode(node);
+            throw;
+        }
+        return detail::attachCallbackNode(_id, cl_int(status), node);
+    }
+
     class CLW_EXPORT UserEvent : public Event
     {
     public:
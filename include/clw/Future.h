@@ -0,0 +1,227 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+
+#include <atomic>
+#include <exception>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace clw
+{
+    namespace detail
+    {
+        template <typename R>
+        struct PromiseFulfiller
+        {
+            template <typename F>
+            static void fulfill(std::promise<R>& promise, F& func, EEventStatus status)
+            {
+                promise.set_value(func(status));
+            }
+        };
+
+        template <>
+        struct PromiseFulfiller<void>
+        {
+            template <typename F>
+            static void fulfill(std::promise<void>& promise, F& func, EEventStatus status)
+            {
+                func(status);
+                promise.set_value();
+            }
+        };
+
+        // std::result_of is gone in C++20
+        template <typename F>
+        struct ContinuationResult
+        {
+            typedef decltype(std::declval<typename std::decay<F>::type&>()
+                (EEventStatus())) type;
+        };
+
+        // Calls func once every event from the list has finished - with
+        // Errored if any of them failed. Runs on driver's callback thread
+        // (or immediately if the list is empty)
+        template <typename F>
+        void whenAllFinished(const EventList& events, F&& func)
+        {
+            typedef typename std::decay<F>::type Callable;
+
+            struct State
+            {
+                State(size_t count, F&& func)
+                    : remaining(count), failed(false), func(std::forward<F>(func)) {}
+
+                void finished(EEventStatus status)
+                {
+                    if(status != EEventStatus::Complete)
+                        failed = true;
+                    if(--remaining == 0)
+                        func(failed ? EEventStatus::Errored : EEventStatus::Complete);
+                }
+
+                std::atomic<size_t> remaining;
+                std::atomic<bool> failed;
+                Callable func;
+            };
+
+            if(events.isEmpty())
+            {
+                Callable call(std::forward<F>(func));
+                call(EEventStatus::Complete);
+                return;
+            }
+
+            // One shared_ptr capture keeps each callback in inline storage
+            std::shared_ptr<State> state = 
+                std::make_shared<State>(events.size(), std::forward<F>(func));
+            for(size_t i = 0; i < events.size(); ++i)
+            {
+                // Callback that couldn't be registered counts as failed event
+                if(!events.at(i).setCallback(EEventStatus::Complete, 
+                        [state](EEventStatus status) { state->finished(status); }))
+                    state->finished(EEventStatus::Errored);
+            }
+        }
+    }
+
+    // Continuation is called with Complete or Errored from driver's thread
+    // once all events finish. Its result (or exception) goes to the future.
+    // Keep it short - hand heavier work off to a CompletionQueue
+    template <typename F>
+    std::future<typename detail::ContinuationResult<F>::type>
+        then(const EventList& events, F&& continuation)
+    {
+        typedef typename detail::ContinuationResult<F>::type Result;
+        typedef typename std::decay<F>::type Callable;
+
+        std::shared_ptr<std::promise<Result>> promise = 
+            std::make_shared<std::promise<Result>>();
+        std::future<Result> future = promise->get_future();
+        std::shared_ptr<Callable> func = 
+            std::make_shared<Callable>(std::forward<F>(continuation));
+
+        detail::whenAllFinished(events, [promise, func](EEventStatus status)
+        {
+            try
+            {
+                detail::PromiseFulfiller<Result>::fulfill(*promise, *func, status);
+            }
+            catch(...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+
+    // Resolves to true once all events complete successfully
+    inline std::future<bool> whenAll(const EventList& events)
+    {
+        return then(events, [](EEventStatus status)
+        {
+            return status == EEventStatus::Complete;
+        });
+    }
+
+    // Future-returning variants of asynchronous commands. Failed enqueue
+    // yields ready future with false (nullptr for maps). Queue is flushed
+    // so callbacks get a chance to fire without anyone waiting on it
+    inline std::future<bool> readBufferFuture(CommandQueue& queue,
+                                              const Buffer& buffer,
+                                              void* data,
+                                              size_t offset,
+                                              size_t size,
+                                              const EventList& after = EventList())
+    {
+        Event event = queue.asyncReadBuffer(buffer, data, offset, size, after);
+        if(event.isNull())
+        {
+            std::promise<bool> failed;
+            failed.set_value(false);
+            return failed.get_future();
+        }
+        queue.flush();
+        return whenAll(event);
+    }
+
+    inline std::future<bool> readBufferFuture(CommandQueue& queue,
+                                              const Buffer& buffer,
+                                              void* data,
+                                              const EventList& after = EventList())
+    {
+        return readBufferFuture(queue, buffer, data, 0, buffer.size(), after);
+    }
+
+    inline std::future<bool> runKernelFuture(CommandQueue& queue,
+                                             const Kernel& kernel,
+                                             const EventList& after = EventList())
+    {
+        Event event = queue.asyncRunKernel(kernel, after);
+        if(event.isNull())
+        {
+            std::promise<bool> failed;
+            failed.set_value(false);
+            return failed.get_future();
+        }
+        queue.flush();
+        return whenAll(event);
+    }
+
+    inline std::future<void*> mapBufferFuture(CommandQueue& queue,
+                                              Buffer& buffer,
+                                              size_t offset,
+                                              size_t size,
+                                              MapAccessFlags access,
+                                              const EventList& after = EventList())
+    {
+        void* data = nullptr;
+        Event event = queue.asyncMapBuffer(buffer, &data, offset, size, access, after);
+        if(event.isNull())
+        {
+            std::promise<void*> failed;
+            failed.set_value(nullptr);
+            return failed.get_future();
+        }
+        queue.flush();
+        return then(event, [data](EEventStatus status) -> void*
+        {
+            return status == EEventStatus::Complete ? data : nullptr;
+        });
+    }
+
+    inline std::future<void*> mapBufferFuture(CommandQueue& queue,
+                                              Buffer& buffer,
+                                              MapAccessFlags access,
+                                              const EventList& after = EventList())
+    {
+        return mapBufferFuture(queue, buffer, 0, buffer.size(), access, after);
+    }
+}
@@ -29,6 +29,8 @@
 #include "clw/KernelTypesTraits.h"
 #include "clw/EnumFlags.h"
 
+#include <memory>
+
 namespace clw
 {
     enum class EKernelArgumentAddressQualifier
@@ -81,6 +83,34 @@ namespace clw
         {}
     };
 
+    namespace detail
+    {
+        struct KernelArgCache;
+    }
+
+    // Number of clSetKernelArg calls made and avoided because argument 
+    // value didn't change since it was last set
+    struct KernelArgumentStatistics
+    {
+        KernelArgumentStatistics() : set(0), skipped(0) {}
+
+        uint64_t set;
+        uint64_t skipped;
+    };
+
+    // Value of kernel argument as last set with Kernel::setArg()
+    struct KernelArgumentValue
+    {
+        KernelArgumentValue() : isSet(false), isMemoryObject(false), size(0) {}
+
+        bool isSet;
+        bool isMemoryObject;
+        size_t size;
+        // Empty for local memory arguments
+        vector<unsigned char> bytes;
+    };
+    typedef vector<KernelArgumentValue> KernelArgumentValues;
+
     class CLW_EXPORT Kernel
     {
     public:
@@ -91,13 +121,7 @@ namespace clw
             , _globalWorkSize(1)
             , _localWorkSize(0)
         {}
-        Kernel(Context* _ctx, cl_kernel _id)
-            : _ctx(_ctx)
-            , _id(_id)
-            , _globalWorkOffset(0)
-            , _globalWorkSize(1)
-            , _localWorkSize(0)
-        {}
+        Kernel(Context* _ctx, cl_kernel _id);
         ~Kernel();
 
         Kernel(const Kernel& other);
@@ -121,6 +145,9 @@ namespace clw
         int preferredMultipleWorkGroupSize(const Device& device = Device()) const;
         uint64_t privateMemoryUsage(const Device& device = Device()) const;
 
+        // True if argument* queries below are available (OpenCL 1.2 and
+        // program built with -cl-kernel-arg-info)
+        bool hasArgumentInfo() const;
         EKernelArgumentAddressQualifier argumentAddressQualifier(int index) const;
         EKernelArgumentAccessQualifier argumentAccessQualifier(int index) const;
         KernelArgumentTypeQualifierFlags argumentTypeQualifier(int index) const;
@@ -167,7 +194,28 @@ namespace clw
         typename std::enable_if<detail::is_local_mem_size<T>::value>::type
             setArg(unsigned index, const T& localMemorySize);
 
+        // Call is skipped if the same value was set last time for given 
+        // argument (with this or any other copy of the kernel object)
         void setArg(unsigned index, const void* data, size_t size);
+        // Same as above but also remembers argument as memory object 
+        // so it can be reported by boundMemoryObjects(). Object is retained
+        // until the argument is set to something else, so a new allocation
+        // reusing the handle of a released one is never mistaken for it
+        // (raw overload above compares bytes only - use this for handles)
+        void setArg(unsigned index, cl_mem memObject);
+
+        // Memory objects currently bound to kernel arguments, split into 
+        // ones kernel can only read from (read-only buffers or, if argument 
+        // info is available, const/__constant arguments) and the rest 
+        void boundMemoryObjects(vector<cl_mem>* reads, vector<cl_mem>* writes) const;
+
+        // Snapshot of argument values to be reapplied later with 
+        // setArguments() (which only sets ones that differ from current)
+        KernelArgumentValues arguments() const;
+        void setArguments(const KernelArgumentValues& values);
+
+        KernelArgumentStatistics argumentStatistics() const;
+        void resetArgumentStatistics();
 
         clw::Event operator()(CommandQueue& queue);
 
@@ -186,6 +234,8 @@ namespace clw
         Grid _globalWorkOffset;
         Grid _globalWorkSize;
         Grid _localWorkSize;
+        // Shadow of argument values shared by all copies (as is cl_kernel)
+        std::shared_ptr<detail::KernelArgCache> _args;
 
         template <class Head, class... Tail>
         void setArgVariadic(unsigned& pos, const Head& head, const Tail&... tail);
@@ -203,8 +253,7 @@ namespace clw
     typename std::enable_if<detail::is_kernel_memory_object<T>::value>::type
         Kernel::setArg(unsigned index, const T& memObject)
     {
-        cl_mem mem = memObject.memoryId();
-        setArg(index, &mem, sizeof(cl_mem));
+        setArg(index, memObject.memoryId());
     }
 
     template <typename T> 
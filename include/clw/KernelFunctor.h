@@ -0,0 +1,252 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Kernel.h"
+#include "clw/Program.h"
+
+namespace clw
+{
+    namespace detail
+    {
+        // How given kernel argument type is passed to clSetKernelArg 
+        // (value and custom types)
+        template <typename T, typename Enable = void>
+        struct kernel_arg_packing
+        {
+            typedef T type;
+            static type pack(const T& value) { return value; }
+            static void set(Kernel& kernel, unsigned index, const type& packed)
+            {
+                kernel.setArg(index, &packed, sizeof(type));
+            }
+            static bool matches(EKernelArgumentAddressQualifier qualifier)
+            {
+                return qualifier == EKernelArgumentAddressQualifier::Private;
+            }
+        };
+
+        template <typename T>
+        struct kernel_arg_packing<T, 
+            typename std::enable_if<is_kernel_memory_object<T>::value>::type>
+        {
+            typedef cl_mem type;
+            static type pack(const T& memObject) { return memObject.memoryId(); }
+            static void set(Kernel& kernel, unsigned index, const type& packed)
+            {
+                kernel.setArg(index, packed);
+            }
+            static bool matches(EKernelArgumentAddressQualifier qualifier)
+            {
+                return qualifier == EKernelArgumentAddressQualifier::Global ||
+                    qualifier == EKernelArgumentAddressQualifier::Constant;
+            }
+        };
+
+        template <typename T>
+        struct kernel_arg_packing<T, 
+            typename std::enable_if<is_local_mem_size<T>::value>::type>
+        {
+            typedef size_t type;
+            static type pack(const T& localMemorySize) { return localMemorySize; }
+            static void set(Kernel& kernel, unsigned index, const type& packed)
+            {
+                kernel.setArg(index, nullptr, packed);
+            }
+            static bool matches(EKernelArgumentAddressQualifier qualifier)
+            {
+                return qualifier == EKernelArgumentAddressQualifier::Local;
+            }
+        };
+
+        // OpenCL C name of scalar type (nullptr if it can't be checked)
+        template <typename T, typename Enable = void>
+        struct kernel_arg_type_name
+        {
+            static const char* get() { return nullptr; }
+        };
+
+        template <typename T>
+        struct kernel_arg_type_name<T, 
+            typename std::enable_if<std::is_integral<T>::value>::type>
+        {
+            static const char* get()
+            {
+                static const char* const names[2][4] = {
+                    { "uchar", "ushort", "uint", "ulong" },
+                    { "char", "short", "int", "long" }
+                };
+                const int index = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : 
+                    sizeof(T) == 4 ? 2 : 3;
+                return names[std::is_signed<T>::value ? 1 : 0][index];
+            }
+        };
+
+        template <>
+        struct kernel_arg_type_name<float>
+        {
+            static const char* get() { return "float"; }
+        };
+
+        template <>
+        struct kernel_arg_type_name<double>
+        {
+            static const char* get() { return "double"; }
+        };
+    }
+
+    // Kernel launcher with fixed signature. Signature is checked once 
+    // against number of kernel arguments and, if program was built with
+    // -cl-kernel-arg-info, their address qualifiers and scalar type names.
+    // Arguments are set through the kernel's own argument shadow, so only
+    // ones that changed since previous launch (through any copy of the 
+    // kernel) are passed to the driver. Movable but not copyable.
+    template <class... Args>
+    class KernelFunctor
+    {
+    public:
+        KernelFunctor() : _valid(false) {}
+        KernelFunctor(const Program& program, const string& name);
+
+        KernelFunctor(KernelFunctor&& other);
+        KernelFunctor& operator=(KernelFunctor&& other);
+
+        KernelFunctor(const KernelFunctor&) = delete;
+        KernelFunctor& operator=(const KernelFunctor&) = delete;
+
+        bool isNull() const { return _kernel.isNull(); }
+        // False if kernel couldn't be created or signature doesn't match
+        bool isValid() const { return _valid; }
+
+        Kernel& kernel() { return _kernel; }
+        const Kernel& kernel() const { return _kernel; }
+
+        // Returns null event if functor is not valid
+        clw::Event operator()(CommandQueue& queue, const Args&... args);
+        clw::Event operator()(CommandQueue& queue, const Grid& local,
+            const Grid& global, const Args&... args);
+
+    private:
+        bool validate() const;
+
+        template <size_t Index>
+        bool validateArgs() const { return true; }
+        template <size_t Index, class Head, class... Tail>
+        bool validateArgs() const;
+
+        template <size_t Index>
+        void setArgs() {}
+        template <size_t Index, class Head, class... Tail>
+        void setArgs(const Head& head, const Tail&... tail);
+
+    private:
+        Kernel _kernel;
+        bool _valid;
+    };
+
+    template <class... Args>
+    KernelFunctor<Args...>::KernelFunctor(const Program& program, 
+                                          const string& name)
+        : _kernel(program.createKernel(name))
+        , _valid(false)
+    {
+        _valid = !_kernel.isNull() && validate();
+    }
+
+    template <class... Args>
+    KernelFunctor<Args...>::KernelFunctor(KernelFunctor&& other)
+        : _kernel(std::move(other._kernel))
+        , _valid(other._valid)
+    {
+        other._valid = false;
+    }
+
+    template <class... Args>
+    KernelFunctor<Args...>& KernelFunctor<Args...>::operator=(KernelFunctor&& other)
+    {
+        if(&other != this)
+        {
+            _kernel = std::move(other._kernel);
+            _valid = other._valid;
+            other._valid = false;
+        }
+        return *this;
+    }
+
+    template <class... Args>
+    clw::Event KernelFunctor<Args...>::operator()(CommandQueue& queue, 
+                                                  const Args&... args)
+    {
+        if(!_valid)
+            return clw::Event();
+        setArgs<0>(args...);
+        return _kernel(queue);
+    }
+
+    template <class... Args>
+    clw::Event KernelFunctor<Args...>::operator()(CommandQueue& queue, 
+                                                  const Grid& local,
+                                                  const Grid& global, 
+                                                  const Args&... args)
+    {
+        if(!_valid)
+            return clw::Event();
+        _kernel.setLocalWorkSize(local);
+        _kernel.setRoundedGlobalWorkSize(global);
+        setArgs<0>(args...);
+        return _kernel(queue);
+    }
+
+    template <class... Args>
+    bool KernelFunctor<Args...>::validate() const
+    {
+        if(_kernel.argCount() != int(sizeof...(Args)))
+            return false;
+        if(!_kernel.hasArgumentInfo())
+            return true;
+        return validateArgs<0, Args...>();
+    }
+
+    template <class... Args>
+    template <size_t Index, class Head, class... Tail>
+    bool KernelFunctor<Args...>::validateArgs() const
+    {
+        if(!detail::kernel_arg_packing<Head>::matches(
+                _kernel.argumentAddressQualifier(int(Index))))
+            return false;
+        const char* typeName = detail::kernel_arg_type_name<Head>::get();
+        if(typeName && _kernel.argumentTypeName(int(Index)) != typeName)
+            return false;
+        return validateArgs<Index + 1, Tail...>();
+    }
+
+    template <class... Args>
+    template <size_t Index, class Head, class... Tail>
+    void KernelFunctor<Args...>::setArgs(const Head& head, const Tail&... tail)
+    {
+        typedef detail::kernel_arg_packing<Head> packing;
+        packing::set(_kernel, unsigned(Index), packing::pack(head));
+        setArgs<Index + 1>(tail...);
+    }
+}
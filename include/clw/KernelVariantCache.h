@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Program.h"
+#include "clw/Kernel.h"
+
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace clw
+{
+    // Compile-time constants passed as -D<name>=<value> 
+    typedef std::map<string, string> KernelDefines;
+
+    // Lazily builds and caches variants of a single program specialized by 
+    // preprocessor defines. Least recently used variants are dropped once 
+    // total size of their binaries exceeds the memory budget (most recently 
+    // used one is always kept). All methods are thread-safe - concurrent 
+    // requests for a variant being built wait for that single build.
+    class CLW_EXPORT KernelVariantCache
+    {
+    public:
+        KernelVariantCache(Context* context, 
+                           const string& sourceCode,
+                           const string& baseOptions = string(),
+                           uint64_t memoryBudget = 64 * 1024 * 1024);
+
+        Context* context() const { return _ctx; }
+        const string& sourceCode() const { return _sourceCode; }
+        const string& baseOptions() const { return _baseOptions; }
+
+        // Returned kernel is shared between all callers requesting the same 
+        // variant - create a separate one from program() if kernel arguments 
+        // are to be set concurrently from many threads
+        Kernel kernel(const string& name, const KernelDefines& defines);
+        Program program(const KernelDefines& defines);
+        bool contains(const KernelDefines& defines) const;
+
+        uint64_t memoryBudget() const;
+        void setMemoryBudget(uint64_t memoryBudget);
+        uint64_t memoryUsage() const;
+        size_t numVariants() const;
+        void clear();
+
+        uint64_t hits() const;
+        uint64_t misses() const;
+
+        static string buildOptions(const string& baseOptions, 
+                                   const KernelDefines& defines);
+
+    private:
+        struct Variant
+        {
+            Program program;
+            uint64_t size;
+            std::map<string, Kernel> kernels;
+            std::list<string>::iterator lru;
+        };
+
+        Variant* findVariant(const string& options);
+        void evict();
+
+    private:
+        Context* _ctx;
+        string _sourceCode;
+        string _baseOptions;
+        uint64_t _memoryBudget;
+        uint64_t _memoryUsage;
+        uint64_t _hits;
+        uint64_t _misses;
+        mutable std::mutex _mutex;
+        // Most recently used at front
+        std::list<string> _lru;
+        std::map<string, Variant> _variants;
+        // Variants currently being built, keyed by build options
+        std::map<string, std::shared_future<Program>> _building;
+    };
+}
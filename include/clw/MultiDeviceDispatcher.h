@@ -0,0 +1,138 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+#include "clw/Grid.h"
+#include "clw/Kernel.h"
+
+namespace clw
+{
+    // Part of the last grid dimension assigned to one device
+    struct DispatchSlice
+    {
+        DispatchSlice() : device(0), begin(0), end(0) {}
+        DispatchSlice(size_t device, size_t begin, size_t end)
+            : device(device), begin(begin), end(end) {}
+
+        size_t size() const { return end - begin; }
+
+        size_t device;
+        size_t begin;
+        size_t end;
+    };
+
+    // Sets arguments of kernel before it's enqueued on given device, 
+    // usually binding that device's buffers from createBuffers()
+    typedef function<void(Kernel& kernel, size_t device)> DispatchArgumentBinder;
+
+    // Splits kernel launches along the last grid dimension across devices 
+    // of one context (each one gets its own profiling queue). Each device 
+    // works on its own full-sized copy of every split buffer (created with
+    // createBuffers()) of which only its slice is scattered and gathered, 
+    // so kernels don't need to know about the split (it's done through 
+    // global work offset, requires +OpenCL 1.1). Split ratios start equal 
+    // and can be rebalanced from measured kernel times.
+    //
+    // Typical iteration: plan(), scatter()/broadcast() inputs, run(), 
+    // gather() outputs, finish() and rebalance(). Queues are in-order so 
+    // commands for the same device don't need to wait for each other.
+    class CLW_EXPORT MultiDeviceDispatcher
+    {
+    public:
+        MultiDeviceDispatcher();
+        // Uses all devices of the context if none given
+        explicit MultiDeviceDispatcher(Context& context,
+            const vector<Device>& devices = vector<Device>());
+
+        bool create(Context& context, 
+                    const vector<Device>& devices = vector<Device>());
+
+        bool isNull() const { return _queues.empty(); }
+        Context* context() const { return _ctx; }
+        size_t numDevices() const { return _queues.size(); }
+        const Device& device(size_t index) const { return _devices[index]; }
+        CommandQueue& commandQueue(size_t index) { return _queues[index]; }
+
+        // Relative amount of work given to each device (sums to 1)
+        const vector<double>& ratios() const { return _ratios; }
+        void setRatios(const vector<double>& ratios);
+
+        // Splits last dimension of global grid in current ratios, in 
+        // multiples of local size in that dimension (if not zero). Used
+        // by subsequent scatter(), run() and gather() calls
+        const vector<DispatchSlice>& plan(const Grid& global, 
+                                          const Grid& local = Grid(0));
+        const vector<DispatchSlice>& slices() const { return _slices; }
+
+        // One buffer of the same size per device
+        vector<Buffer> createBuffers(EAccess access, 
+                                     EMemoryLocation location, 
+                                     size_t size);
+
+        // Writes each device's slice of host data (bytesPerSlice bytes per
+        // unit of the last dimension, e.g. row pitch) to its buffer. Halo 
+        // extends slices by given number of units on both sides.
+        EventList scatter(vector<Buffer>& buffers,
+                          const void* data,
+                          size_t bytesPerSlice,
+                          size_t halo = 0,
+                          const EventList& after = EventList());
+        // Writes whole host data to every buffer
+        EventList broadcast(vector<Buffer>& buffers,
+                            const void* data,
+                            size_t size,
+                            const EventList& after = EventList());
+        // Reads back each device's slice into host data
+        EventList gather(const vector<Buffer>& buffers,
+                         void* data,
+                         size_t bytesPerSlice,
+                         const EventList& after = EventList());
+
+        // Enqueues kernel (with its global work size replaced by the planned
+        // one) once per slice. Returned events are also used by rebalance()
+        EventList run(const Kernel& kernel,
+                      const DispatchArgumentBinder& binder = DispatchArgumentBinder(),
+                      const EventList& after = EventList());
+
+        void finish();
+
+        // Moves ratios towards measured throughput (slice size per kernel
+        // time) of last run(). Smoothing is the weight of the new 
+        // measurement. Returns false if there's nothing to measure
+        bool rebalance(double smoothing = 0.5);
+
+    private:
+        Context* _ctx;
+        vector<Device> _devices;
+        vector<CommandQueue> _queues;
+        vector<double> _ratios;
+        Grid _global;
+        vector<DispatchSlice> _slices;
+        // Kernel events of last run(), one per slice
+        vector<Event> _kernelEvents;
+    };
+}
@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Grid.h"
+
+namespace clw
+{
+    // Resource that bounds number of concurrent work-groups per compute unit
+    enum class EOccupancyLimit
+    {
+        None,
+        // Local size exceeds what kernel (or device) allows
+        WorkGroupSize,
+        LocalMemory,
+        // Estimated from kernel's maximum work-group size (NVIDIA only)
+        Registers,
+        // Hardware limit of resident warps/wavefronts
+        WavefrontSlots,
+        // Hardware limit of resident work-groups
+        WorkGroupSlots
+    };
+
+    struct OccupancyEstimate
+    {
+        OccupancyEstimate()
+            : workGroupSize(0)
+            , simdWidth(1)
+            , wavefrontsPerGroup(0)
+            , groupsPerComputeUnit(0)
+            , wavefrontsPerComputeUnit(0)
+            , maximumWavefrontsPerComputeUnit(0)
+            , occupancy(0.0f)
+            , localMemoryPerGroup(0)
+            , limit(EOccupancyLimit::None)
+        {}
+
+        bool isValid() const { return groupsPerComputeUnit > 0; }
+
+        size_t workGroupSize;
+        // Warp (NVIDIA), wavefront (AMD) or preferred work-group size multiple
+        size_t simdWidth;
+        int wavefrontsPerGroup;
+        // Predicted number of concurrently resident work-groups
+        int groupsPerComputeUnit;
+        int wavefrontsPerComputeUnit;
+        int maximumWavefrontsPerComputeUnit;
+        // Resident wavefronts relative to hardware maximum (0 - 1)
+        float occupancy;
+        uint64_t localMemoryPerGroup;
+        EOccupancyLimit limit;
+    };
+
+    // Predicts occupancy of a compute unit for given local work size.
+    // dynamicLocalMemory is per-group size of __local arguments not set yet
+    // (ones already set are accounted by Kernel::localMemoryUsage()).
+    // Vendor specific limits are used when device exposes 
+    // cl_nv_device_attribute_query or cl_amd_device_attribute_query
+    CLW_EXPORT OccupancyEstimate estimateOccupancy(const Kernel& kernel,
+                                                   const Device& device,
+                                                   const Grid& localSize,
+                                                   uint64_t dynamicLocalMemory = 0);
+
+    // Picks local work size with the best estimated occupancy, preferring
+    // less global size padding and bigger groups when occupancy is equal. 
+    // localMemoryPerWorkItem is size of not yet set __local arguments 
+    // that scale with work-group size
+    CLW_EXPORT Grid recommendLocalWorkSize(const Kernel& kernel,
+                                           const Device& device,
+                                           const Grid& globalSize,
+                                           uint64_t localMemoryPerWorkItem = 0);
+}
@@ -43,6 +43,9 @@ namespace clw
     class Context;
     class CommandQueue;
     class Program;
+    class ProgramCache;
+    class ProgramBundle;
+    struct DeviceFingerprint;
     class LocalMemorySize;
     template <class> class TypedLocalMemorySize;
     class Kernel;
@@ -24,6 +24,8 @@
 
 #include "clw/Prerequisites.h"
 
+#include <future>
+
 namespace clw
 {
     typedef vector<unsigned char> ByteCode;
@@ -47,26 +49,46 @@ namespace clw
         Context* context() const { return _ctx; }
         cl_program programId() const { return _id; }
         
-        bool isBuilt() const { return _built; }
+        // Also true if program has been successfully built asynchronously
+        bool isBuilt() const;
         bool build(string options = string());
+        // Returns immediately, result becomes available when driver finishes
+        // build for all devices. Program object must not be rebuilt until then
+        std::shared_future<bool> buildAsync(string options = string());
         // !TODO:
         //bool build(const vector<Device> devices, const string& options = string());
         
+        // Compiles (without linking) program to an object (OpenCL 1.2). 
+        // Headers are source-only programs visible to #include under 
+        // corresponding name from headerNames
+        bool compile(string options = string(),
+                     const vector<Program>& headers = vector<Program>(),
+                     const vector<string>& headerNames = vector<string>());
+
         string buildOptions() const { return _options; }
         string log() const;
         
         vector<Device> devices() const;
         string sourceCode() const;
         vector<ByteCode> binaries() const;
+        vector<size_t> binarySizes() const;
 
         Kernel createKernel(const char* name) const;
         Kernel createKernel(const string& name) const;
         vector<Kernel> createKernels() const;
         
     private:
+        friend class Context;
+
         Context* _ctx;
         cl_program _id;
         string _options;
-        bool _built;
+        mutable bool _built;
     };
-}
\ No newline at end of file
+
+    // Builds all programs concurrently using up to numThreads threads
+    // (0 means number of hardware threads). Returns true if all succeeded
+    CLW_EXPORT bool buildPrograms(vector<Program>& programs, 
+                                  const string& options = string(),
+                                  unsigned numThreads = 0);
+}
@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Program.h"
+
+namespace clw
+{
+    // Identifies device and software stack a program binary was built with
+    struct CLW_EXPORT DeviceFingerprint
+    {
+        string name;
+        string vendor;
+        string driverVersion;
+        string deviceVersion;
+        string platformVersion;
+
+        DeviceFingerprint() {}
+        explicit DeviceFingerprint(const Device& device);
+
+        bool isNull() const { return name.empty(); }
+        string toString() const;
+
+        bool operator==(const DeviceFingerprint& other) const;
+        bool operator!=(const DeviceFingerprint& other) const
+        {
+            return !operator==(other);
+        }
+    };
+
+    // Program binaries for many devices (together with build options) 
+    // packed in a single file
+    class CLW_EXPORT ProgramBundle
+    {
+    public:
+        struct Entry
+        {
+            DeviceFingerprint fingerprint;
+            ByteCode binary;
+        };
+
+        ProgramBundle() {}
+        // Captures binaries (for every device) and build options of built program
+        explicit ProgramBundle(const Program& program);
+
+        bool isEmpty() const { return _entries.empty(); }
+        size_t size() const { return _entries.size(); }
+        const vector<Entry>& entries() const { return _entries; }
+
+        const string& buildOptions() const { return _options; }
+        void setBuildOptions(const string& options) { _options = options; }
+
+        // Replaces binary with the same fingerprint if already present
+        void addBinary(const DeviceFingerprint& fingerprint, const ByteCode& binary);
+        bool addProgram(const Program& program);
+
+        const ByteCode* findBinary(const DeviceFingerprint& fingerprint) const;
+        const ByteCode* findBinary(const Device& device) const;
+
+        ByteCode serialize() const;
+        bool deserialize(const ByteCode& data);
+
+        bool load(const string& fileName);
+        bool save(const string& fileName) const;
+
+    private:
+        string _options;
+        vector<Entry> _entries;
+    };
+}
@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+
+#include <atomic>
+
+namespace clw
+{
+    // Persistent, on-disk cache of built program binaries. Entries are keyed
+    // by source code, build options and fingerprints (name, driver and
+    // platform version) of every device in the context. Each entry lives in 
+    // its own file which is published atomically so many processes can 
+    // share the same cache directory.
+    class CLW_EXPORT ProgramCache
+    {
+    public:
+        ProgramCache();
+        explicit ProgramCache(const string& directory);
+
+        // Directory is created (non-recursively) if it doesn't exist yet
+        bool setDirectory(const string& directory);
+        const string& directory() const { return _directory; }
+        bool isValid() const { return !_directory.empty(); }
+
+        // Returns built program - from cached binaries if possible,
+        // otherwise compiled from sources and stored in the cache
+        Program buildProgramFromSourceCode(Context& context,
+                                           const string& sourceCode,
+                                           const string& options = string());
+        Program buildProgramFromSourceFile(Context& context,
+                                           const string& fileName,
+                                           const string& options = string());
+
+        // Removes entry for given source and options (if any)
+        bool remove(const Context& context,
+                    const string& sourceCode, 
+                    const string& options = string());
+
+        uint64_t hits() const { return _hits; }
+        uint64_t misses() const { return _misses; }
+        void resetStatistics();
+
+    private:
+        string entryKey(const Context& context,
+                        const string& sourceCode,
+                        const string& options) const;
+        string entryFileName(const string& key) const;
+
+        Program loadProgram(Context& context,
+                            const string& key,
+                            const string& options);
+        bool storeProgram(const Context& context,
+                          const string& key,
+                          const Program& program);
+
+    private:
+        string _directory;
+        std::atomic<uint64_t> _hits;
+        std::atomic<uint64_t> _misses;
+    };
+}
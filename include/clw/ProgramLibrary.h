@@ -0,0 +1,86 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Program.h"
+
+#include <map>
+#include <mutex>
+
+namespace clw
+{
+    // Compiles shared (utility) code once and links it into many programs 
+    // (OpenCL 1.2). Headers are visible to #include directives of every 
+    // compiled source. Compiled modules are cached per compile options.
+    // All methods are thread-safe.
+    class CLW_EXPORT ProgramLibrary
+    {
+    public:
+        explicit ProgramLibrary(Context* context = nullptr);
+
+        Context* context() const { return _ctx; }
+        // Drops everything compiled for previous context
+        void setContext(Context* context);
+
+        void addHeader(const string& includeName, const string& sourceCode);
+        bool addHeaderFromFile(const string& includeName, const string& fileName);
+        // Replaces source of existing module and drops its compiled objects
+        void addModule(const string& name, const string& sourceCode);
+        bool addModuleFromFile(const string& name, const string& fileName);
+        bool hasModule(const string& name) const;
+
+        // Returns compiled object of given module, compiling it on first use
+        Program compiledModule(const string& name, 
+                               const string& options = string());
+
+        // Compiles source code with given options and links it together 
+        // with (compiled with the same options) modules
+        Program buildProgram(const string& sourceCode,
+                             const vector<string>& modules,
+                             const string& options = string(),
+                             const string& linkOptions = string());
+        Program buildProgramFromFile(const string& fileName,
+                                     const vector<string>& modules,
+                                     const string& options = string(),
+                                     const string& linkOptions = string());
+
+        size_t numCompiledModules() const;
+        // Drops compiled objects, keeps headers and module sources
+        void clear();
+
+    private:
+        Program compile(const string& sourceCode, const string& options);
+
+    private:
+        typedef std::pair<string, string> ModuleKey;
+
+        Context* _ctx;
+        mutable std::mutex _mutex;
+        vector<Program> _headers;
+        vector<string> _headerNames;
+        vector<string> _headerSources;
+        std::map<string, string> _modules;
+        std::map<ModuleKey, Program> _compiled;
+    };
+}
@@ -0,0 +1,132 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+
+#include <mutex>
+
+namespace clw
+{
+    // Transfers pageable host memory through a ring of persistently mapped 
+    // pinned (AllocHostMemory) buffers. Transfers are split into slot-sized
+    // chunks so host memcpy of one chunk overlaps DMA of the previous one.
+    // Slots are recycled once their transfer completes. Asynchronous calls
+    // never wait for slots - chunks that find none free go directly from 
+    // (a copy of) host memory instead. Blocking calls wait for their own 
+    // transfer only. All methods are thread-safe, although concurrent 
+    // transfers compete for the same slots.
+    class CLW_EXPORT StagingRing
+    {
+    public:
+        StagingRing();
+        StagingRing(const CommandQueue& queue,
+                    size_t slotSize = 4 * 1024 * 1024,
+                    size_t numSlots = 4);
+        ~StagingRing();
+
+        bool create(const CommandQueue& queue,
+                    size_t slotSize = 4 * 1024 * 1024,
+                    size_t numSlots = 4);
+        // Blocks until pending transfers finish and unmaps slots
+        void release();
+
+        bool isNull() const { return _slots.empty(); }
+        const CommandQueue& commandQueue() const { return _queue; }
+        size_t slotSize() const { return _slotSize; }
+        size_t numSlots() const { return _slots.size(); }
+
+        // Same as CommandQueue counterparts. Host data is copied before 
+        // function returns so it can be reused right away
+        Event asyncWriteBuffer(Buffer& buffer,
+                               const void* data,
+                               size_t offset,
+                               size_t size,
+                               const EventList& after = EventList());
+        Event asyncWriteBuffer(Buffer& buffer,
+                               const void* data,
+                               const EventList& after = EventList());
+        // Blocks until the whole transfer completes
+        bool writeBuffer(Buffer& buffer,
+                         const void* data,
+                         size_t offset,
+                         size_t size);
+
+        // Data is copied to destination from driver's callback thread, 
+        // destination must stay valid until returned event completes
+        Event asyncReadBuffer(const Buffer& buffer,
+                              void* data,
+                              size_t offset,
+                              size_t size,
+                              const EventList& after = EventList());
+        Event asyncReadBuffer(const Buffer& buffer,
+                              void* data,
+                              const EventList& after = EventList());
+        // Blocks until the whole transfer completes
+        bool readBuffer(const Buffer& buffer,
+                        void* data,
+                        size_t offset,
+                        size_t size);
+
+    private:
+        struct Slot
+        {
+            Slot() : data(nullptr) {}
+
+            Buffer buffer;
+            void* data;
+            // Slot can be reused after this one completes
+            Event lastUse;
+        };
+
+        // Next slot whose last transfer has finished, null if all are busy
+        Slot* tryAcquireSlot();
+
+    private:
+        StagingRing(const StagingRing&);
+        StagingRing& operator=(const StagingRing&);
+
+        CommandQueue _queue;
+        size_t _slotSize;
+        vector<Slot> _slots;
+        size_t _nextSlot;
+        std::mutex _mutex;
+    };
+
+    inline Event StagingRing::asyncWriteBuffer(Buffer& buffer,
+                                               const void* data,
+                                               const EventList& after)
+    {
+        return asyncWriteBuffer(buffer, data, 0, buffer.size(), after);
+    }
+
+    inline Event StagingRing::asyncReadBuffer(const Buffer& buffer,
+                                              void* data,
+                                              const EventList& after)
+    {
+        return asyncReadBuffer(buffer, data, 0, buffer.size(), after);
+    }
+}
@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Buffer.h"
+#include "clw/CommandQueue.h"
+#include "clw/Event.h"
+
+namespace clw
+{
+    // Part of the input processed by a single kernel stage invocation
+    struct StreamingChunk
+    {
+        size_t index;
+        // In elements, relative to the whole input
+        size_t offset;
+        size_t count;
+        // Slot buffers holding (at least) count input and output elements
+        Buffer* input;
+        Buffer* output;
+    };
+
+    // Enqueues processing of a chunk on given queue, after given events.
+    // Returns event of the last enqueued command
+    typedef function<Event(CommandQueue& queue, 
+                           const StreamingChunk& chunk,
+                           const EventList& after)> StreamingKernelStage;
+
+    struct StreamingStatistics
+    {
+        StreamingStatistics()
+            : chunks(0)
+            , elements(0)
+            , bytesUploaded(0)
+            , bytesDownloaded(0)
+            , hostStalls(0)
+            , elapsedNs(0)
+        {}
+
+        // Processed bytes (up and down) per second
+        double throughput() const
+        {
+            return elapsedNs ? (bytesUploaded + bytesDownloaded) * 1e9 / elapsedNs : 0.0;
+        }
+
+        uint64_t chunks;
+        uint64_t elements;
+        uint64_t bytesUploaded;
+        uint64_t bytesDownloaded;
+        // Times host had to wait for a slot to become free
+        uint64_t hostStalls;
+        uint64_t elapsedNs;
+    };
+
+    // Streams data larger than device memory through N slots, each with own
+    // input and output buffers, overlapping upload, kernel and readback of 
+    // different chunks. Slots are assigned to queues round-robin - stages
+    // of different slots overlap only if they land on different queues 
+    // (or an out-of-order one), hence the default of one queue per slot.
+    // Host blocks only when a slot is about to be reused.
+    class CLW_EXPORT StreamingPipeline
+    {
+    public:
+        StreamingPipeline();
+        // Creates one in-order queue per slot
+        StreamingPipeline(Context* context, 
+                          const Device& device,
+                          size_t chunkElements,
+                          size_t numSlots = 3);
+        StreamingPipeline(const vector<CommandQueue>& queues,
+                          size_t chunkElements,
+                          size_t numSlots = 3);
+
+        bool create(Context* context, 
+                    const Device& device,
+                    size_t chunkElements,
+                    size_t numSlots = 3);
+        bool create(const vector<CommandQueue>& queues,
+                    size_t chunkElements,
+                    size_t numSlots = 3);
+
+        bool isNull() const { return _slots.empty(); }
+        size_t chunkElements() const { return _chunkElements; }
+        size_t numSlots() const { return _slots.size(); }
+        const vector<CommandQueue>& commandQueues() const { return _queues; }
+
+        // Processes numElements elements of input, writing results to output 
+        // (pass nullptr or zero output element size to skip readback). 
+        // Blocks until everything is done. Host memory should preferably
+        // be pinned for the DMA to actually overlap
+        bool run(const void* input, 
+                 size_t inputElementSize,
+                 void* output,
+                 size_t outputElementSize,
+                 size_t numElements,
+                 const StreamingKernelStage& stage);
+
+        // Accumulated over all run() calls
+        const StreamingStatistics& statistics() const { return _stats; }
+        void resetStatistics() { _stats = StreamingStatistics(); }
+
+    private:
+        struct Slot
+        {
+            size_t queueIndex;
+            Buffer input;
+            Buffer output;
+            // Last command using slot's buffers
+            Event done;
+        };
+
+        bool reserveBuffers(size_t inputBytes, size_t outputBytes);
+
+    private:
+        vector<CommandQueue> _queues;
+        vector<Slot> _slots;
+        size_t _chunkElements;
+        StreamingStatistics _stats;
+    };
+}
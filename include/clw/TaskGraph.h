@@ -0,0 +1,117 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/CommandQueue.h"
+#include "clw/Kernel.h"
+#include "clw/Event.h"
+
+namespace clw
+{
+    // Enqueues node's command(s) after given events, returns event of the
+    // last enqueued command
+    typedef function<Event(CommandQueue& queue, const EventList& after)> TaskFunction;
+
+    // Graph of commands with dependencies derived from memory objects they
+    // read and write (read-after-write, write-after-read, write-after-write),
+    // in order of insertion. Sub-buffers conflict with their parent and
+    // with other sub-buffers overlapping them. compile() reduces dependencies to the minimal 
+    // set, spreads independent branches over given queues and drops edges 
+    // already implied by in-order queues. Compiled graph can then be 
+    // executed any number of times. Consecutive executions are ordered by 
+    // the same rules as if graph was appended to itself - nodes wait for 
+    // previous execution's nodes that last accessed their memory.
+    class CLW_EXPORT TaskGraph
+    {
+    public:
+        typedef size_t NodeId;
+
+        TaskGraph() : _compiled(false) {}
+        explicit TaskGraph(const vector<CommandQueue>& queues);
+
+        const vector<CommandQueue>& commandQueues() const { return _queues; }
+        void setCommandQueues(const vector<CommandQueue>& queues);
+
+        // Queue index of -1 lets compile() choose one
+        NodeId addTask(const TaskFunction& task,
+                       const vector<const MemoryObject*>& reads,
+                       const vector<const MemoryObject*>& writes,
+                       int queueIndex = -1);
+        // Called before every execution to (re)bind kernel arguments
+        NodeId addKernel(const Kernel& kernel,
+                         const vector<const MemoryObject*>& reads,
+                         const vector<const MemoryObject*>& writes,
+                         const function<void(Kernel&)>& bindArgs = nullptr,
+                         int queueIndex = -1);
+        NodeId addWriteBuffer(Buffer& buffer, const void* data,
+                              size_t offset, size_t size, 
+                              int queueIndex = -1);
+        NodeId addReadBuffer(const Buffer& buffer, void* data,
+                             size_t offset, size_t size, 
+                             int queueIndex = -1);
+        NodeId addCopyBuffer(const Buffer& src, const Buffer& dst,
+                             int queueIndex = -1);
+        // Additional dependency not visible through memory objects
+        void addDependency(NodeId before, NodeId after);
+
+        size_t numNodes() const { return _nodes.size(); }
+        void clear();
+
+        bool compile();
+        bool isCompiled() const { return _compiled; }
+        // Number of dependencies that need explicit event wait lists
+        size_t numEdges() const;
+        int nodeQueue(NodeId node) const;
+
+        // Compiles graph first if needed. Root nodes (with no dependency 
+        // within the graph) also wait for given events. Returns events of 
+        // all sink nodes
+        EventList execute(const EventList& after = EventList());
+
+    private:
+        struct Node
+        {
+            TaskFunction task;
+            vector<cl_mem> reads;
+            vector<cl_mem> writes;
+            vector<NodeId> extraDeps;
+            int requestedQueue;
+            // Filled by compile()
+            int queue;
+            vector<NodeId> waitFor;
+            // Nodes of previous execution
+            vector<NodeId> waitForPrevious;
+            bool isRoot;
+            bool isSink;
+        };
+
+    private:
+        vector<CommandQueue> _queues;
+        vector<Node> _nodes;
+        vector<Event> _events;
+        // Queue index each event was enqueued on, -1 if not known
+        vector<int> _eventQueues;
+        bool _compiled;
+    };
+}
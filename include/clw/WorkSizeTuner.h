@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "clw/Prerequisites.h"
+#include "clw/Grid.h"
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace clw
+{
+    // Finds the fastest local work size for given kernel, device and global 
+    // work size by timing candidate configurations with profiling events.
+    // Winners are kept in a tuning database (text file, one entry per line)
+    // so later runs can skip benchmarking. All methods are thread-safe.
+    class CLW_EXPORT WorkSizeTuner
+    {
+    public:
+        WorkSizeTuner();
+        // Loads database if the file exists. save() writes back to it
+        explicit WorkSizeTuner(const string& databaseFile);
+        ~WorkSizeTuner();
+
+        const string& databaseFile() const { return _databaseFile; }
+        bool load(const string& fileName);
+        bool save() const;
+        bool save(const string& fileName) const;
+
+        int iterations() const { return _iterations; }
+        void setIterations(int iterations);
+
+        // Returns the best local work size, benchmarking kernel if there's 
+        // no entry for it yet. Kernel arguments must be set already and 
+        // repeated runs must be harmless. On return kernel has the best 
+        // local work size and rounded global work size set
+        Grid tune(Kernel& kernel, CommandQueue& queue, const Grid& globalSize);
+        bool lookup(const Kernel& kernel, const Device& device, 
+                    const Grid& globalSize, Grid* localSize) const;
+
+        size_t size() const;
+        // Also drops cached program identities (and references to programs)
+        void clear();
+
+        // Local work sizes within kernel and device limits. Zero-sized 
+        // grid (let implementation decide) is always included
+        static vector<Grid> candidates(const Kernel& kernel, 
+                                       const Device& device,
+                                       const Grid& globalSize);
+
+    private:
+        struct Entry
+        {
+            Grid localSize;
+            uint64_t timeNs;
+        };
+
+        // Kernel name, program identity, device fingerprint and global size
+        string entryKey(const Kernel& kernel, const Device& device,
+                        const Grid& globalSize) const;
+        string programIdentity(const Kernel& kernel, const Device& device) const;
+        bool lookup(const string& key, Grid* localSize) const;
+        void releaseIdentities();
+
+    private:
+        string _databaseFile;
+        int _iterations;
+        mutable std::mutex _mutex;
+        std::map<string, Entry> _entries;
+        // Hash of build options and source (or binaries) per program and 
+        // device, computed once. Programs are retained while cached so 
+        // their handles can't be reused by other programs
+        mutable std::map<std::pair<cl_program, cl_device_id>, string> _identities;
+    };
+}
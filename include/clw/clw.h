@@ -27,11 +27,29 @@
 #include "clw/DeviceFilter.h"
 #include "clw/Context.h"
 #include "clw/CommandQueue.h"
+#include "clw/CommandList.h"
+#include "clw/CommandQueuePool.h"
+#include "clw/CommandSubmitter.h"
 #include "clw/Program.h"
+#include "clw/ProgramBundle.h"
+#include "clw/ProgramCache.h"
+#include "clw/ProgramLibrary.h"
 #include "clw/Kernel.h"
+#include "clw/KernelFunctor.h"
+#include "clw/KernelVariantCache.h"
 #include "clw/MemoryObject.h"
 #include "clw/Buffer.h"
+#include "clw/BufferArena.h"
+#include "clw/BufferPool.h"
 #include "clw/Image.h"
 #include "clw/Grid.h"
 #include "clw/Event.h"
+#include "clw/CompletionQueue.h"
+#include "clw/Future.h"
 #include "clw/Sampler.h"
+#include "clw/StagingRing.h"
+#include "clw/StreamingPipeline.h"
+#include "clw/TaskGraph.h"
+#include "clw/MultiDeviceDispatcher.h"
+#include "clw/WorkSizeTuner.h"
+#include "clw/Occupancy.h"
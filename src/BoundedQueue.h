@@ -0,0 +1,141 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace clw
+{
+    namespace detail
+    {
+        // Lock-free bounded multi-producer multi-consumer queue (Vyukov's). 
+        // Each cell carries a sequence number telling whether it's free for
+        // the producer or filled for the consumer of given position
+        template <typename T>
+        class BoundedQueue
+        {
+        public:
+            // Capacity is rounded up to power of two
+            explicit BoundedQueue(size_t capacity)
+                : _enqueuePos(0)
+                , _dequeuePos(0)
+            {
+                size_t size = 2;
+                while(size < capacity)
+                    size *= 2;
+                _mask = size - 1;
+                _cells.reset(new Cell[size]);
+                for(size_t i = 0; i < size; ++i)
+                    _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            size_t capacity() const { return _mask + 1; }
+
+            bool tryPush(T&& value)
+            {
+                Cell* cell;
+                size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+                for(;;)
+                {
+                    cell = &_cells[pos & _mask];
+                    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                    const ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos);
+                    if(diff == 0)
+                    {
+                        if(_enqueuePos.compare_exchange_weak(pos, pos + 1, 
+                                std::memory_order_relaxed))
+                            break;
+                    }
+                    else if(diff < 0)
+                    {
+                        // Full
+                        return false;
+                    }
+                    else
+                    {
+                        pos = _enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+                cell->value = std::move(value);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool tryPop(T& value)
+            {
+                Cell* cell;
+                size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+                for(;;)
+                {
+                    cell = &_cells[pos & _mask];
+                    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                    const ptrdiff_t diff = ptrdiff_t(seq) - ptrdiff_t(pos + 1);
+                    if(diff == 0)
+                    {
+                        if(_dequeuePos.compare_exchange_weak(pos, pos + 1, 
+                                std::memory_order_relaxed))
+                            break;
+                    }
+                    else if(diff < 0)
+                    {
+                        // Empty
+                        return false;
+                    }
+                    else
+                    {
+                        pos = _dequeuePos.load(std::memory_order_relaxed);
+                    }
+                }
+                value = std::move(cell->value);
+                cell->value = T();
+                cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            struct Cell
+            {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            // Producers and consumers touch different cache lines
+            static const size_t cacheLineSize = 64;
+
+            std::unique_ptr<Cell[]> _cells;
+            size_t _mask;
+            char _pad0[cacheLineSize];
+            std::atomic<size_t> _enqueuePos;
+            char _pad1[cacheLineSize];
+            std::atomic<size_t> _dequeuePos;
+            char _pad2[cacheLineSize];
+
+        private:
+            BoundedQueue(const BoundedQueue&);
+            BoundedQueue& operator=(const BoundedQueue&);
+        };
+    }
+}
@@ -0,0 +1,239 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/BufferArena.h"
+#include "clw/Context.h"
+#include "details.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace clw
+{
+    BufferArena::BufferArena()
+        : _access(EAccess::ReadWrite)
+        , _mode(EArenaMode::FreeList)
+        , _capacity(0)
+        , _alignment(1)
+        , _top(0)
+        , _used(0)
+    {
+    }
+
+    BufferArena::BufferArena(Context* context, 
+                             EAccess access, 
+                             EMemoryLocation location,
+                             size_t capacity,
+                             EArenaMode mode)
+        : _access(access)
+        , _mode(mode)
+        , _capacity(0)
+        , _alignment(1)
+        , _top(0)
+        , _used(0)
+    {
+        create(context, access, location, capacity, mode);
+    }
+
+    bool BufferArena::create(Context* context, 
+                             EAccess access, 
+                             EMemoryLocation location,
+                             size_t capacity,
+                             EArenaMode mode)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _buffer = Buffer();
+        _access = access;
+        _mode = mode;
+        _capacity = 0;
+        _alignment = 1;
+        _top = 0;
+        _used = 0;
+        _freeBlocks.clear();
+        _allocations.clear();
+        if(!context)
+            return false;
+
+        // CL_DEVICE_MEM_BASE_ADDR_ALIGN is given in bits
+        for(const Device& device : context->devices())
+        {
+            _alignment = std::max(_alignment, size_t(device.defaultAlignment() / 8));
+            _alignment = std::max(_alignment, size_t(device.minimumAlignment()));
+        }
+        capacity = alignUp(capacity);
+        _buffer = context->createBuffer(access, location, capacity);
+        if(_buffer.isNull())
+            return false;
+        _capacity = capacity;
+        _freeBlocks[0] = _capacity;
+        return true;
+    }
+
+    Buffer BufferArena::allocate(size_t size)
+    {
+        return allocate(size, _access);
+    }
+
+    Buffer BufferArena::allocate(size_t size, EAccess access)
+    {
+        if(isNull() || size == 0)
+            return Buffer();
+
+        const size_t alignedSize = alignUp(size);
+        size_t offset = 0;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(_mode == EArenaMode::Linear)
+            {
+                if(alignedSize > _capacity - _top)
+                    return Buffer();
+                offset = _top;
+                _top += alignedSize;
+            }
+            else
+            {
+                auto it = _freeBlocks.begin();
+                while(it != _freeBlocks.end() && it->second < alignedSize)
+                    ++it;
+                if(it == _freeBlocks.end())
+                    return Buffer();
+                offset = it->first;
+                const size_t remaining = it->second - alignedSize;
+                _freeBlocks.erase(it);
+                if(remaining > 0)
+                    _freeBlocks[offset + alignedSize] = remaining;
+            }
+            _used += alignedSize;
+        }
+
+        // Sub-buffer is created with requested (not aligned) size
+        Buffer subBuffer = _buffer.createSubBuffer(offset, size, access);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(subBuffer.isNull())
+        {
+            // Give the block back
+            _used -= alignedSize;
+            if(_mode == EArenaMode::Linear)
+            {
+                if(_top == offset + alignedSize)
+                    _top = offset;
+            }
+            else
+            {
+                _freeBlocks[offset] = alignedSize;
+            }
+            return Buffer();
+        }
+        _allocations[subBuffer.memoryId()] = Block(offset, alignedSize);
+        return subBuffer;
+    }
+
+    bool BufferArena::isNull() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _buffer.isNull();
+    }
+
+    void BufferArena::free(const Buffer& subBuffer)
+    {
+        if(_mode != EArenaMode::FreeList || subBuffer.isNull())
+            return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto alloc = _allocations.find(subBuffer.memoryId());
+        if(alloc == _allocations.end())
+            return;
+#if defined(HAVE_OPENCL_1_1)
+        // Handle of a sub-buffer dropped without free() may have been 
+        // reused by an unrelated memory object since
+        cl_mem parent = nullptr;
+        size_t subOffset = 0;
+        if(clGetMemObjectInfo(subBuffer.memoryId(), CL_MEM_ASSOCIATED_MEMOBJECT,
+                sizeof(cl_mem), &parent, nullptr) != CL_SUCCESS ||
+                parent != _buffer.memoryId() ||
+                clGetMemObjectInfo(subBuffer.memoryId(), CL_MEM_OFFSET,
+                    sizeof(size_t), &subOffset, nullptr) != CL_SUCCESS ||
+                subOffset != alloc->second.first)
+        {
+            _allocations.erase(alloc);
+            return;
+        }
+#endif
+        size_t offset = alloc->second.first;
+        size_t size = alloc->second.second;
+        _allocations.erase(alloc);
+        _used -= size;
+
+        // Coalesce with neighbouring free blocks
+        auto next = _freeBlocks.lower_bound(offset);
+        if(next != _freeBlocks.end() && offset + size == next->first)
+        {
+            size += next->second;
+            next = _freeBlocks.erase(next);
+        }
+        if(next != _freeBlocks.begin())
+        {
+            auto prev = std::prev(next);
+            if(prev->first + prev->second == offset)
+            {
+                prev->second += size;
+                return;
+            }
+        }
+        _freeBlocks[offset] = size;
+    }
+
+    void BufferArena::reset()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _top = 0;
+        _used = 0;
+        _allocations.clear();
+        _freeBlocks.clear();
+        if(_capacity > 0)
+            _freeBlocks[0] = _capacity;
+    }
+
+    size_t BufferArena::usedBytes() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _used;
+    }
+
+    size_t BufferArena::numAllocations() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _allocations.size();
+    }
+
+    size_t BufferArena::largestFreeBlock() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_mode == EArenaMode::Linear)
+            return _capacity - _top;
+        size_t largest = 0;
+        for(const auto& block : _freeBlocks)
+            largest = std::max(largest, block.second);
+        return largest;
+    }
+}
@@ -0,0 +1,295 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/BufferPool.h"
+#include "clw/Context.h"
+#include "details.h"
+
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+
+namespace clw
+{
+    namespace detail
+    {
+        struct OutstandingBuffers
+        {
+            typedef std::tuple<size_t, EAccess, EMemoryLocation> Key;
+
+            OutstandingBuffers() : bytes(0) {}
+
+            void insert(cl_mem mem, const Key& key)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = buffers.find(mem);
+                if(it != buffers.end())
+                    bytes -= std::get<0>(it->second);
+                buffers[mem] = key;
+                bytes += std::get<0>(key);
+            }
+
+            bool take(cl_mem mem, Key* key)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = buffers.find(mem);
+                if(it == buffers.end())
+                    return false;
+                if(key)
+                    *key = it->second;
+                bytes -= std::get<0>(it->second);
+                buffers.erase(it);
+                return true;
+            }
+
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                buffers.clear();
+                bytes = 0;
+            }
+
+            std::mutex mutex;
+            std::unordered_map<cl_mem, Key> buffers;
+            uint64_t bytes;
+        };
+
+#if defined(HAVE_OPENCL_1_1)
+        void CL_CALLBACK bufferDestroyed(cl_mem mem, void* userData)
+        {
+            std::shared_ptr<OutstandingBuffers>* outstanding = 
+                static_cast<std::shared_ptr<OutstandingBuffers>*>(userData);
+            (*outstanding)->take(mem, nullptr);
+            delete outstanding;
+        }
+#endif
+
+        // Handle of a buffer can only be reused after it's destroyed, 
+        // by which time its entry is gone
+        void watchDestruction(cl_mem mem, 
+                              const std::shared_ptr<OutstandingBuffers>& outstanding)
+        {
+#if defined(HAVE_OPENCL_1_1)
+            std::shared_ptr<OutstandingBuffers>* userData = 
+                new std::shared_ptr<OutstandingBuffers>(outstanding);
+            if(clSetMemObjectDestructorCallback(mem, &bufferDestroyed, 
+                    userData) != CL_SUCCESS)
+                delete userData;
+#else
+            (void) mem;
+            (void) outstanding;
+#endif
+        }
+    }
+
+    BufferPool::BufferPool(Context* context, uint64_t budget)
+        : _ctx(context)
+        , _budget(budget)
+        , _outstanding(std::make_shared<detail::OutstandingBuffers>())
+    {
+    }
+
+    void BufferPool::setContext(Context* context)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_ctx == context)
+            return;
+        trimLocked(0);
+        _outstanding->clear();
+        _ctx = context;
+    }
+
+    Buffer BufferPool::acquire(EAccess access, EMemoryLocation location, size_t size)
+    {
+        if(location == EMemoryLocation::UseHostMemory || size == 0)
+        {
+            detail::reportError("BufferPool::acquire(): ", CL_INVALID_VALUE);
+            return Buffer();
+        }
+
+        const Key key(sizeClass(size), access, location);
+        std::unique_lock<std::mutex> lock(_mutex);
+        if(!_ctx)
+            return Buffer();
+
+        auto it = _idleByKey.find(key);
+        if(it != _idleByKey.end())
+        {
+            Buffer buffer = std::move(it->second->buffer);
+            removeIdle(it->second);
+            _idleByKey.erase(it);
+            _outstanding->insert(buffer.memoryId(), key);
+            ++_stats.hits;
+            return buffer;
+        }
+
+        ++_stats.misses;
+        Context* ctx = _ctx;
+        lock.unlock();
+
+        Buffer buffer = ctx->createBuffer(access, location, std::get<0>(key));
+        if(buffer.isNull())
+        {
+            // Idle buffers might be what keeps us from allocating
+            trim(0);
+            buffer = ctx->createBuffer(access, location, std::get<0>(key));
+            if(buffer.isNull())
+                return Buffer();
+        }
+
+        lock.lock();
+        // Context got replaced while allocating - hand the buffer out 
+        // unpooled, release() will just drop it
+        if(_ctx != ctx)
+            return buffer;
+        _outstanding->insert(buffer.memoryId(), key);
+        detail::watchDestruction(buffer.memoryId(), _outstanding);
+        return buffer;
+    }
+
+    void BufferPool::release(Buffer buffer)
+    {
+        if(buffer.isNull())
+            return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        Key key;
+        if(!_outstanding->take(buffer.memoryId(), &key))
+            return;
+
+        // Entry may be stale (acquired buffer dropped without release() and
+        // its handle value reused since) - pool only what really matches
+        cl_context bufferContext = nullptr;
+        if(!_ctx || 
+                clGetMemObjectInfo(buffer.memoryId(), CL_MEM_CONTEXT, 
+                    sizeof(cl_context), &bufferContext, nullptr) != CL_SUCCESS ||
+                bufferContext != _ctx->contextId() ||
+                buffer.size() != std::get<0>(key) ||
+                buffer.access() != std::get<1>(key) ||
+                buffer.memoryLocation() != std::get<2>(key))
+            return;
+
+        const uint64_t size = std::get<0>(key);
+        if(size > _budget)
+        {
+            ++_stats.evictions;
+            return;
+        }
+        trimLocked(_budget - size);
+
+        IdleBuffer idle;
+        idle.key = key;
+        idle.buffer = std::move(buffer);
+        _idle.push_front(std::move(idle));
+        _idleByKey.insert(std::make_pair(key, _idle.begin()));
+        ++_stats.idleBuffers;
+        _stats.idleBytes += size;
+    }
+
+    uint64_t BufferPool::budget() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _budget;
+    }
+
+    void BufferPool::setBudget(uint64_t budget)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _budget = budget;
+        trimLocked(_budget);
+    }
+
+    void BufferPool::trim(uint64_t maxIdleBytes)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        trimLocked(maxIdleBytes);
+    }
+
+    BufferPoolStatistics BufferPool::statistics() const
+    {
+        BufferPoolStatistics stats;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            stats = _stats;
+        }
+        std::lock_guard<std::mutex> lock(_outstanding->mutex);
+        stats.outstandingBuffers = _outstanding->buffers.size();
+        stats.outstandingBytes = _outstanding->bytes;
+        return stats;
+    }
+
+    void BufferPool::resetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats.hits = 0;
+        _stats.misses = 0;
+        _stats.evictions = 0;
+    }
+
+    size_t BufferPool::sizeClass(size_t size)
+    {
+        // Powers of two up to 4kB, above that every power of two interval
+        // is split into four classes so no more than 25% is wasted
+        const size_t minimumClass = 4096;
+        if(size <= minimumClass)
+        {
+            size_t cls = 256;
+            while(cls < size)
+                cls <<= 1;
+            return cls;
+        }
+        // Doubling below would overflow - such requests aren't rounded
+        if(size > std::numeric_limits<size_t>::max() / 2)
+            return size;
+        size_t pow = minimumClass;
+        while(pow * 2 < size)
+            pow <<= 1;
+        const size_t step = pow / 4;
+        return (size + step - 1) / step * step;
+    }
+
+    void BufferPool::trimLocked(uint64_t maxIdleBytes)
+    {
+        while(_stats.idleBytes > maxIdleBytes && !_idle.empty())
+        {
+            auto last = std::prev(_idle.end());
+            auto range = _idleByKey.equal_range(last->key);
+            for(auto it = range.first; it != range.second; ++it)
+            {
+                if(it->second == last)
+                {
+                    _idleByKey.erase(it);
+                    break;
+                }
+            }
+            removeIdle(last);
+            ++_stats.evictions;
+        }
+    }
+
+    void BufferPool::removeIdle(IdleList::iterator it)
+    {
+        --_stats.idleBuffers;
+        _stats.idleBytes -= std::get<0>(it->key);
+        _idle.erase(it);
+    }
+}
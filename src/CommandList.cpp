@@ -0,0 +1,427 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/CommandList.h"
+#include "clw/Device.h"
+#include "clw/Platform.h"
+#include "details.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+
+namespace clw
+{
+    namespace detail
+    {
+        // cl_khr_command_buffer types and entry points, spelled out here 
+        // as not every OpenCL SDK ships them in cl_ext.h
+        typedef struct _cl_command_buffer_khr* command_buffer_khr;
+        typedef struct _cl_mutable_command_khr* mutable_command_khr;
+        typedef cl_ulong command_buffer_properties_khr;
+        typedef cl_ulong command_properties_khr;
+        typedef cl_uint sync_point_khr;
+
+        typedef command_buffer_khr (CL_API_CALL *CreateCommandBufferKHR)(
+            cl_uint, const cl_command_queue*, 
+            const command_buffer_properties_khr*, cl_int*);
+        typedef cl_int (CL_API_CALL *FinalizeCommandBufferKHR)(
+            command_buffer_khr);
+        typedef cl_int (CL_API_CALL *ReleaseCommandBufferKHR)(
+            command_buffer_khr);
+        typedef cl_int (CL_API_CALL *EnqueueCommandBufferKHR)(
+            cl_uint, cl_command_queue*, command_buffer_khr, 
+            cl_uint, const cl_event*, cl_event*);
+        typedef cl_int (CL_API_CALL *CommandNDRangeKernelKHR)(
+            command_buffer_khr, cl_command_queue, const command_properties_khr*,
+            cl_kernel, cl_uint, const size_t*, const size_t*, const size_t*,
+            cl_uint, const sync_point_khr*, sync_point_khr*, mutable_command_khr*);
+        typedef cl_int (CL_API_CALL *CommandCopyBufferKHR)(
+            command_buffer_khr, cl_command_queue, const command_properties_khr*,
+            cl_mem, cl_mem, size_t, size_t, size_t,
+            cl_uint, const sync_point_khr*, sync_point_khr*, mutable_command_khr*);
+        typedef cl_int (CL_API_CALL *CommandFillBufferKHR)(
+            command_buffer_khr, cl_command_queue, const command_properties_khr*,
+            cl_mem, const void*, size_t, size_t, size_t,
+            cl_uint, const sync_point_khr*, sync_point_khr*, mutable_command_khr*);
+
+        struct CommandBufferFunctions
+        {
+            CreateCommandBufferKHR createCommandBuffer;
+            FinalizeCommandBufferKHR finalizeCommandBuffer;
+            ReleaseCommandBufferKHR releaseCommandBuffer;
+            EnqueueCommandBufferKHR enqueueCommandBuffer;
+            CommandNDRangeKernelKHR commandNDRangeKernel;
+            CommandCopyBufferKHR commandCopyBuffer;
+            CommandFillBufferKHR commandFillBuffer;
+        };
+
+        // OpenCL 3.0 query, needed as entry points changed before 0.9.5
+        const cl_device_info deviceExtensionsWithVersion = 0x1060;
+        const cl_uint commandBufferMinimumVersion = (0 << 22) | (9 << 12) | 5;
+
+        struct ExtensionNameVersion
+        {
+            cl_uint version;
+            char name[64];
+        };
+
+        bool supportsCommandBuffer(cl_device_id device)
+        {
+            size_t size;
+            if(clGetDeviceInfo(device, deviceExtensionsWithVersion, 
+                    0, nullptr, &size) != CL_SUCCESS || !size)
+                return false;
+            vector<ExtensionNameVersion> exts(size / sizeof(ExtensionNameVersion));
+            if(clGetDeviceInfo(device, deviceExtensionsWithVersion, 
+                    exts.size() * sizeof(ExtensionNameVersion), 
+                    exts.data(), nullptr) != CL_SUCCESS)
+                return false;
+            for(const auto& ext : exts)
+            {
+                if(strncmp(ext.name, "cl_khr_command_buffer", sizeof(ext.name)) == 0)
+                    return ext.version >= commandBufferMinimumVersion;
+            }
+            return false;
+        }
+
+        template<typename Function>
+        bool resolveFunction(Function& function, 
+                             cl_platform_id platform, 
+                             const char* name)
+        {
+#if defined(HAVE_OPENCL_1_2)
+            void* address = clGetExtensionFunctionAddressForPlatform(platform, name);
+#else
+            (void) platform;
+            void* address = clGetExtensionFunctionAddress(name);
+#endif
+            function = reinterpret_cast<Function>(address);
+            return function != nullptr;
+        }
+
+        // Resolved once per platform, nullptr if device can't record
+        const CommandBufferFunctions* commandBufferFunctions(const Device& device)
+        {
+            static std::mutex mutex;
+            static std::map<cl_platform_id, CommandBufferFunctions> resolved;
+
+            if(!supportsCommandBuffer(device.deviceId()))
+                return nullptr;
+            const cl_platform_id platform = device.platform().platformId();
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = resolved.find(platform);
+            if(it == resolved.end())
+            {
+                CommandBufferFunctions fns;
+                const bool ok = 
+                    resolveFunction(fns.createCommandBuffer, platform, "clCreateCommandBufferKHR") &&
+                    resolveFunction(fns.finalizeCommandBuffer, platform, "clFinalizeCommandBufferKHR") &&
+                    resolveFunction(fns.releaseCommandBuffer, platform, "clReleaseCommandBufferKHR") &&
+                    resolveFunction(fns.enqueueCommandBuffer, platform, "clEnqueueCommandBufferKHR") &&
+                    resolveFunction(fns.commandNDRangeKernel, platform, "clCommandNDRangeKernelKHR") &&
+                    resolveFunction(fns.commandCopyBuffer, platform, "clCommandCopyBufferKHR") &&
+                    resolveFunction(fns.commandFillBuffer, platform, "clCommandFillBufferKHR");
+                if(!ok)
+                    fns.createCommandBuffer = nullptr;
+                it = resolved.insert(std::make_pair(platform, fns)).first;
+            }
+            return it->second.createCommandBuffer ? &it->second : nullptr;
+        }
+    }
+
+    CommandList::CommandList()
+        : _native(nullptr)
+        , _buffer(nullptr)
+        , _lastSyncPoint(0)
+        , _size(0)
+        , _finalized(false)
+    {
+    }
+
+    CommandList::CommandList(const CommandQueue& queue, bool allowNative)
+        : _native(nullptr)
+        , _buffer(nullptr)
+        , _lastSyncPoint(0)
+        , _size(0)
+        , _finalized(false)
+    {
+        create(queue, allowNative);
+    }
+
+    CommandList::~CommandList()
+    {
+        release();
+    }
+
+    bool CommandList::create(const CommandQueue& queue, bool allowNative)
+    {
+        release();
+        if(queue.isNull())
+            return false;
+        _queue = queue;
+
+        // Native command buffers would need sync points between every 
+        // command on out-of-order queue anyway
+        if(!allowNative || _queue.isOutOfOrder())
+            return true;
+        const detail::CommandBufferFunctions* fns = 
+            detail::commandBufferFunctions(_queue.device());
+        if(!fns)
+            return true;
+        cl_command_queue id = _queue.commandQueueId();
+        cl_int error;
+        detail::command_buffer_khr buffer = 
+            fns->createCommandBuffer(1, &id, nullptr, &error);
+        if(error != CL_SUCCESS)
+        {
+            // Not fatal, host-side list is used instead
+            detail::reportError("CommandList::create(): ", error);
+            return true;
+        }
+        _native = fns;
+        _buffer = buffer;
+        return true;
+    }
+
+    void CommandList::release()
+    {
+        if(_buffer)
+            _native->releaseCommandBuffer(static_cast<detail::command_buffer_khr>(_buffer));
+        _native = nullptr;
+        _buffer = nullptr;
+        _lastSyncPoint = 0;
+        _commands.clear();
+        _size = 0;
+        _finalized = false;
+        _queue = CommandQueue();
+    }
+
+    bool CommandList::recordKernel(const Kernel& kernel)
+    {
+        if(isNull() || _finalized || kernel.isNull())
+        {
+            detail::reportError("CommandList::recordKernel(): ", CL_INVALID_OPERATION);
+            return false;
+        }
+
+        if(_native)
+        {
+            const Grid& offset = kernel.globalWorkOffset();
+            const Grid& global = kernel.globalWorkSize();
+            const Grid& local = kernel.localWorkSize();
+            const size_t* l = local;
+            if(local.width() == 0)
+                l = nullptr;
+
+            detail::sync_point_khr syncPoint;
+            cl_int error = _native->commandNDRangeKernel(
+                static_cast<detail::command_buffer_khr>(_buffer), nullptr, nullptr,
+                kernel.kernelId(), cl_uint(global.dimensions()), offset, global, l,
+                _size ? 1 : 0, _size ? &_lastSyncPoint : nullptr, &syncPoint, nullptr);
+            if(error != CL_SUCCESS)
+            {
+                detail::reportError("CommandList::recordKernel(): ", error);
+                return false;
+            }
+            _lastSyncPoint = syncPoint;
+        }
+        else
+        {
+            Command command;
+            command.type = ECommandType::NDRangeKernel;
+            command.kernel = kernel;
+            command.arguments = kernel.arguments();
+            _commands.push_back(std::move(command));
+        }
+        ++_size;
+        return true;
+    }
+
+    bool CommandList::recordCopyBuffer(const Buffer& src,
+                                       size_t srcOffset,
+                                       const Buffer& dst,
+                                       size_t dstOffset,
+                                       size_t size)
+    {
+        if(isNull() || _finalized)
+        {
+            detail::reportError("CommandList::recordCopyBuffer(): ", CL_INVALID_OPERATION);
+            return false;
+        }
+
+        if(_native)
+        {
+            detail::sync_point_khr syncPoint;
+            cl_int error = _native->commandCopyBuffer(
+                static_cast<detail::command_buffer_khr>(_buffer), nullptr, nullptr,
+                src.memoryId(), dst.memoryId(), srcOffset, dstOffset, size,
+                _size ? 1 : 0, _size ? &_lastSyncPoint : nullptr, &syncPoint, nullptr);
+            if(error != CL_SUCCESS)
+            {
+                detail::reportError("CommandList::recordCopyBuffer(): ", error);
+                return false;
+            }
+            _lastSyncPoint = syncPoint;
+        }
+        else
+        {
+            Command command;
+            command.type = ECommandType::CopyBuffer;
+            command.src = src;
+            command.dst = dst;
+            command.srcOffset = srcOffset;
+            command.dstOffset = dstOffset;
+            command.size = size;
+            _commands.push_back(std::move(command));
+        }
+        ++_size;
+        return true;
+    }
+
+    bool CommandList::recordFillBuffer(const Buffer& buffer,
+                                       const void* pattern,
+                                       size_t patternSize,
+                                       size_t offset,
+                                       size_t size)
+    {
+#if defined(HAVE_OPENCL_1_2)
+        if(isNull() || _finalized)
+        {
+            detail::reportError("CommandList::recordFillBuffer(): ", CL_INVALID_OPERATION);
+            return false;
+        }
+
+        if(_native)
+        {
+            detail::sync_point_khr syncPoint;
+            cl_int error = _native->commandFillBuffer(
+                static_cast<detail::command_buffer_khr>(_buffer), nullptr, nullptr,
+                buffer.memoryId(), pattern, patternSize, offset, size,
+                _size ? 1 : 0, _size ? &_lastSyncPoint : nullptr, &syncPoint, nullptr);
+            if(error != CL_SUCCESS)
+            {
+                detail::reportError("CommandList::recordFillBuffer(): ", error);
+                return false;
+            }
+            _lastSyncPoint = syncPoint;
+        }
+        else
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(pattern);
+            Command command;
+            command.type = ECommandType::FillBuffer;
+            command.dst = buffer;
+            command.dstOffset = offset;
+            command.size = size;
+            command.pattern.assign(bytes, bytes + patternSize);
+            _commands.push_back(std::move(command));
+        }
+        ++_size;
+        return true;
+#else
+        (void) buffer;
+        (void) pattern;
+        (void) patternSize;
+        (void) offset;
+        (void) size;
+        detail::reportError("CommandList::recordFillBuffer(): ", CL_INVALID_OPERATION);
+        return false;
+#endif
+    }
+
+    bool CommandList::finalize()
+    {
+        if(isNull())
+            return false;
+        if(_finalized)
+            return true;
+        if(_buffer)
+        {
+            cl_int error = _native->finalizeCommandBuffer(
+                static_cast<detail::command_buffer_khr>(_buffer));
+            if(error != CL_SUCCESS)
+            {
+                detail::reportError("CommandList::finalize(): ", error);
+                return false;
+            }
+        }
+        _finalized = true;
+        return true;
+    }
+
+    Event CommandList::replay(const EventList& after)
+    {
+        if(!finalize())
+            return Event();
+        if(_size == 0)
+            return _queue.asyncMarker(after);
+
+        if(_native)
+        {
+            cl_event event;
+            cl_int error = _native->enqueueCommandBuffer(0, nullptr,
+                static_cast<detail::command_buffer_khr>(_buffer),
+                cl_uint(after.size()), after, &event);
+            if(error != CL_SUCCESS)
+            {
+                detail::reportError("CommandList::replay(): ", error);
+                return Event();
+            }
+            return Event(event);
+        }
+
+        // Each command waits for the previous one which keeps recorded 
+        // order on out-of-order queue too
+        const bool chain = _queue.isOutOfOrder();
+        EventList wait = after;
+        Event last;
+        for(Command& command : _commands)
+        {
+            switch(command.type)
+            {
+            case ECommandType::NDRangeKernel:
+                // Only arguments changed since last replay are set again
+                command.kernel.setArguments(command.arguments);
+                last = _queue.asyncRunKernel(command.kernel, wait);
+                break;
+            case ECommandType::CopyBuffer:
+                last = _queue.asyncCopyBuffer(command.src, command.srcOffset,
+                    command.dst, command.dstOffset, command.size, wait);
+                break;
+            case ECommandType::FillBuffer:
+                last = _queue.asyncFillBuffer(command.dst, command.pattern.data(),
+                    command.pattern.size(), command.dstOffset, command.size, wait);
+                break;
+            default:
+                break;
+            }
+            if(last.isNull())
+                return Event();
+            if(chain)
+                wait = EventList(last);
+            else if(!wait.isEmpty())
+                wait = EventList();
+        }
+        return last;
+    }
+}
@@ -27,6 +27,10 @@
 #include "clw/Grid.h"
 #include "details.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 namespace clw
 {
     namespace detail
@@ -44,6 +48,147 @@ namespace clw
             }
             return (props & prop) != 0;
         }
+
+        bool isPending(const Event& event)
+        {
+            cl_int status;
+            return !event.isNull() && clGetEventInfo(event.eventId(), 
+                CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), 
+                &status, nullptr) == CL_SUCCESS && status > CL_COMPLETE;
+        }
+
+        // Mapping for writing counts as write as host may modify the 
+        // region before it's unmapped
+        cl_mem mapWrites(MapAccessFlags access, const MemoryObject& obj)
+        {
+            return access.testFlag(EMapAccess::Write) ||
+                access.testFlag(EMapAccess::InvalidateRegion) ? obj.memoryId() : 0;
+        }
+
+        class HazardTracker
+        {
+        public:
+            HazardTracker() : _recorded(0) {}
+
+            void dependencies(EventList& list, 
+                              const vector<cl_mem>& reads,
+                              const vector<cl_mem>& writes)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                // Read after write
+                for(cl_mem mem : reads)
+                {
+                    const MemoryRange range = memoryRange(mem);
+                    auto it = _accesses.find(range.root);
+                    if(it == _accesses.end())
+                        continue;
+                    for(const Access& access : it->second)
+                    {
+                        if(access.range.overlaps(range))
+                            append(list, access.writer);
+                    }
+                }
+                // Write after write and write after read
+                for(cl_mem mem : writes)
+                {
+                    const MemoryRange range = memoryRange(mem);
+                    auto it = _accesses.find(range.root);
+                    if(it == _accesses.end())
+                        continue;
+                    for(const Access& access : it->second)
+                    {
+                        if(!access.range.overlaps(range))
+                            continue;
+                        append(list, access.writer);
+                        for(const Event& reader : access.readers)
+                            append(list, reader);
+                    }
+                }
+            }
+
+            void record(const Event& event, 
+                        const vector<cl_mem>& reads,
+                        const vector<cl_mem>& writes)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for(cl_mem mem : reads)
+                    access(memoryRange(mem)).readers.push_back(event);
+                // Writer supersedes everything before it on exactly the same
+                // range (including its own read). Partially overlapping 
+                // ranges keep their history - still hazards for the rest
+                for(cl_mem mem : writes)
+                {
+                    Access& acc = access(memoryRange(mem));
+                    acc.writer = event;
+                    acc.readers.clear();
+                }
+                if(++_recorded % pruneInterval == 0)
+                    prune();
+            }
+
+        private:
+            struct Access
+            {
+                MemoryRange range;
+                Event writer;
+                vector<Event> readers;
+            };
+
+            static const size_t pruneInterval = 64;
+
+            std::mutex _mutex;
+            // Keyed by root allocation so sub-buffers aliasing each other 
+            // (or their parent) are checked against each other
+            std::unordered_map<cl_mem, vector<Access>> _accesses;
+            size_t _recorded;
+
+            Access& access(const MemoryRange& range)
+            {
+                vector<Access>& accesses = _accesses[range.root];
+                for(Access& acc : accesses)
+                {
+                    if(acc.range.offset == range.offset && acc.range.size == range.size)
+                        return acc;
+                }
+                Access acc;
+                acc.range = range;
+                accesses.push_back(acc);
+                return accesses.back();
+            }
+
+            static void append(EventList& list, const Event& event)
+            {
+                if(isPending(event) && !list.contains(event))
+                    list.append(event);
+            }
+
+            // Drops finished commands so released events (and memory 
+            // objects whose handles might get reused) don't pile up
+            void prune()
+            {
+                for(auto it = _accesses.begin(); it != _accesses.end(); )
+                {
+                    vector<Access>& accesses = it->second;
+                    for(Access& acc : accesses)
+                    {
+                        if(!isPending(acc.writer))
+                            acc.writer = Event();
+                        acc.readers.erase(std::remove_if(acc.readers.begin(), 
+                            acc.readers.end(), [](const Event& reader) {
+                                return !isPending(reader);
+                            }), acc.readers.end());
+                    }
+                    accesses.erase(std::remove_if(accesses.begin(), accesses.end(),
+                        [](const Access& acc) {
+                            return acc.writer.isNull() && acc.readers.empty();
+                        }), accesses.end());
+                    if(accesses.empty())
+                        it = _accesses.erase(it);
+                    else
+                        ++it;
+                }
+            }
+        };
     }
 
     CommandQueue::~CommandQueue()
@@ -53,7 +198,7 @@ namespace clw
     }
 
     CommandQueue::CommandQueue(const CommandQueue& other)
-        : _ctx(other._ctx), _id(other._id)
+        : _ctx(other._ctx), _id(other._id), _tracker(other._tracker)
     {
         if(_id)
             clRetainCommandQueue(_id);
@@ -67,6 +212,7 @@ namespace clw
         if(_id)
             clReleaseCommandQueue(_id);
         _id = other._id;
+        _tracker = other._tracker;
         return *this;
     }
 
@@ -84,12 +230,26 @@ namespace clw
                 clReleaseCommandQueue(_id);
             _ctx = other._ctx;
             _id = other._id;
+            _tracker = std::move(other._tracker);
             other._ctx = nullptr;
             other._id = 0;
         }
         return *this;
     }
 
+    Device CommandQueue::device() const
+    {
+        cl_device_id did;
+        cl_int error = CL_SUCCESS;
+        if(!_id || (error = clGetCommandQueueInfo(_id, CL_QUEUE_DEVICE,
+                sizeof(cl_device_id), &did, nullptr)) != CL_SUCCESS)
+        {
+            detail::reportError("CommandQueue::device(): ", error);
+            return Device();
+        }
+        return Device(did);
+    }
+
     bool CommandQueue::isProfilingEnabled() const
     {
         return detail::commandQueueInfo(_id, CL_QUEUE_PROFILING_ENABLE);
@@ -100,6 +260,67 @@ namespace clw
         return detail::commandQueueInfo(_id, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
     }
 
+    void CommandQueue::setHazardTracking(bool enabled)
+    {
+        if(!enabled)
+            _tracker.reset();
+        else if(!_tracker)
+            _tracker = std::make_shared<detail::HazardTracker>();
+    }
+
+    void CommandQueue::appendHazards(EventList& list, 
+                                     const vector<cl_mem>& reads, 
+                                     const vector<cl_mem>& writes) const
+    {
+        if(_tracker)
+            _tracker->dependencies(list, reads, writes);
+    }
+
+    void CommandQueue::appendHazards(EventList& list, 
+                                     cl_mem read, cl_mem write) const
+    {
+        if(_tracker)
+        {
+            _tracker->dependencies(list, 
+                vector<cl_mem>(read ? 1 : 0, read), 
+                vector<cl_mem>(write ? 1 : 0, write));
+        }
+    }
+
+    const EventList& CommandQueue::waitList(const EventList& after, 
+                                            EventList& deps,
+                                            cl_mem read, 
+                                            cl_mem write) const
+    {
+        if(!_tracker)
+            return after;
+        deps = after;
+        appendHazards(deps, read, write);
+        return deps;
+    }
+
+    Event CommandQueue::track(cl_event event, 
+                              const vector<cl_mem>& reads, 
+                              const vector<cl_mem>& writes)
+    {
+        Event e(event);
+        if(_tracker)
+            _tracker->record(e, reads, writes);
+        return e;
+    }
+
+    Event CommandQueue::track(cl_event event, cl_mem read, cl_mem write)
+    {
+        Event e(event);
+        if(_tracker)
+        {
+            _tracker->record(e, 
+                vector<cl_mem>(read ? 1 : 0, read), 
+                vector<cl_mem>(write ? 1 : 0, write));
+        }
+        return e;
+    }
+
     void CommandQueue::finish()
     {
         cl_int err = clFinish(_id);
@@ -118,9 +339,11 @@ namespace clw
                                   size_t size)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, buffer.memoryId(), 0);
         if((error = clEnqueueReadBuffer(_id, buffer.memoryId(), 
                 CL_TRUE, offset, size, data,
-                0, nullptr, nullptr)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::readBuffer() ", error);
             return false;
@@ -136,14 +359,16 @@ namespace clw
     {
         cl_event event;
         cl_int error;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, buffer.memoryId(), 0);
         if((error = clEnqueueReadBuffer(_id, buffer.memoryId(), 
                 CL_FALSE, offset, size, data,
-                cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncReadBuffer() ", error);
-            return Event(event);
+            return Event();
         }
-        return Event(event);
+        return track(event, buffer.memoryId(), 0);
     }
 
     bool CommandQueue::writeBuffer(Buffer& buffer,
@@ -152,9 +377,11 @@ namespace clw
                                    size_t size)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, 0, buffer.memoryId());
         if((error = clEnqueueWriteBuffer(_id, buffer.memoryId(), 
                 CL_TRUE, offset, size, data,
-                0, nullptr, nullptr)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::writeBuffer() ", error);
             return false;
@@ -170,14 +397,16 @@ namespace clw
     {
         cl_event event;
         cl_int error;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, 0, buffer.memoryId());
         if((error = clEnqueueWriteBuffer(_id, buffer.memoryId(), 
                 CL_FALSE, offset, size, data,
-                cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncWriteBuffer() ", error);
-            return Event(event);
+            return Event();
         }
-        return Event(event);
+        return track(event, 0, buffer.memoryId());
     }
 
     Event CommandQueue::asyncCopyBuffer(const Buffer& src,
@@ -189,14 +418,16 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, src.memoryId(), dst.memoryId());
         if((error = clEnqueueCopyBuffer(_id, src.memoryId(), dst.memoryId(), 
-                srcOffset, dstOffset, size, cl_uint(after.size()), 
-                after, &event)) != CL_SUCCESS)
+                srcOffset, dstOffset, size, cl_uint(wait.size()), 
+                wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncCopyBuffer() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, src.memoryId(), dst.memoryId());
     }
 
     bool CommandQueue::writeBufferRect(Buffer& buffer,
@@ -208,11 +439,13 @@ namespace clw
                                        size_t bufferBytesPerSlice)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, 0, buffer.memoryId());
         size_t host_origin[] = {0,0,0};
         if((error = clEnqueueWriteBufferRect(_id, buffer.memoryId(),
                 CL_TRUE, rect.origin(), host_origin, rect.region(),
                 bufferBytesPerLine, bufferBytesPerSlice, bytesPerLine, 
-                bytesPerSlice, data, 0, nullptr, nullptr)) != CL_SUCCESS)
+                bytesPerSlice, data, cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::writeBufferRect() ", error);
             return false;
@@ -229,11 +462,13 @@ namespace clw
                                       size_t bufferBytesPerSlice)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, buffer.memoryId(), 0);
         size_t host_origin[] = {0,0,0};
         if((error = clEnqueueReadBufferRect(_id, buffer.memoryId(), 
                 CL_TRUE, rect.origin(), host_origin, rect.region(),
                 bufferBytesPerLine, bufferBytesPerSlice, bytesPerLine,
-                bytesPerSlice, data, 0, nullptr, nullptr)) != CL_SUCCESS)
+                bytesPerSlice, data, cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::readBufferRect() ", error);
             return false;
@@ -253,15 +488,17 @@ namespace clw
         cl_int error;
         cl_event event;
         size_t host_origin[] = {0,0,0};
+        EventList deps;
+        const EventList& wait = waitList(after, deps, 0, buffer.memoryId());
         if((error = clEnqueueWriteBufferRect(_id, buffer.memoryId(),
                 CL_FALSE, rect.origin(), host_origin, rect.region(),
                 bufferBytesPerLine, bufferBytesPerSlice, bytesPerLine, 
-                bytesPerSlice, data, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                bytesPerSlice, data, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncWriteBufferRect() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, 0, buffer.memoryId());
     }
 
     Event CommandQueue::asyncReadBufferRect(const Buffer& buffer,
@@ -276,15 +513,17 @@ namespace clw
         cl_int error;
         cl_event event;
         size_t host_origin[] = {0,0,0};
+        EventList deps;
+        const EventList& wait = waitList(after, deps, buffer.memoryId(), 0);
         if((error = clEnqueueReadBufferRect(_id, buffer.memoryId(), 
                 CL_FALSE, rect.origin(), host_origin, rect.region(),
                 bufferBytesPerLine, bufferBytesPerSlice, bytesPerLine,
-                bytesPerSlice, data, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                bytesPerSlice, data, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncReadBufferRect() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, buffer.memoryId(), 0);
     }
 
     Event CommandQueue::asyncCopyBufferRect(const Buffer& src,
@@ -299,15 +538,17 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, src.memoryId(), dst.memoryId());
         if((error = clEnqueueCopyBufferRect(_id, src.memoryId(), dst.memoryId(), 
                 rect.origin(), dstOrigin.origin(), rect.region(), 
                 srcBytesPerLine, srcBytesPerSlice, dstBytesPerLine,
-                dstBytesPerSlice, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                dstBytesPerSlice, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncCopyBufferRect() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, src.memoryId(), dst.memoryId());
     }
 
     bool CommandQueue::readImage2D(const Image2D& image,
@@ -316,9 +557,11 @@ namespace clw
                                    int bytesPerLine)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, image.memoryId(), 0);
         if((error = clEnqueueReadImage(_id, image.memoryId(),
                 CL_TRUE, rect.origin(), rect.region(), bytesPerLine, 0, 
-                data, 0, nullptr, nullptr)) != CL_SUCCESS)
+                data, cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::readImage2D() ", error);
             return false;
@@ -334,14 +577,16 @@ namespace clw
     {
         cl_event event;
         cl_int error;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, image.memoryId(), 0);
         if((error = clEnqueueReadImage(_id, image.memoryId(),
                 CL_FALSE, rect.origin(), rect.region(), bytesPerLine, 0, 
-                data, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                data, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncReadImage2D() ", error);
-            return Event(event);
+            return Event();
         }
-        return Event(event);
+        return track(event, image.memoryId(), 0);
     }
 
     bool CommandQueue::writeImage2D(Image2D& image,
@@ -350,9 +595,11 @@ namespace clw
                                     int bytesPerLine)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, 0, image.memoryId());
         if((error = clEnqueueWriteImage(_id, image.memoryId(),
                 CL_TRUE, rect.origin(), rect.region(), bytesPerLine, 0, 
-                data, 0, nullptr, nullptr)) != CL_SUCCESS)
+                data, cl_uint(wait.size()), wait, nullptr)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::writeImage2D() ", error);
             return false;
@@ -368,14 +615,16 @@ namespace clw
     {
         cl_event event;
         cl_int error;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, 0, image.memoryId());
         if((error = clEnqueueWriteImage(_id, image.memoryId(),
                 CL_FALSE, rect.origin(), rect.region(), bytesPerLine, 0, 
-                data, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                data, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncWriteImage2D() ", error);
-            return Event(event);
+            return Event();
         }
-        return Event(event);
+        return track(event, 0, image.memoryId());
     }
 
     Event CommandQueue::asyncCopyImage(const Image2D& src,
@@ -386,14 +635,16 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, src.memoryId(), dst.memoryId());
         if((error = clEnqueueCopyImage(_id, src.memoryId(), dst.memoryId(),
                 srcRect.origin(), dstOrigin.origin(), srcRect.region(),
-                cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncCopyImage() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, src.memoryId(), dst.memoryId());
     }
 
     Event CommandQueue::asyncCopyImageToBuffer(const clw::Image2D& image,
@@ -404,14 +655,16 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, image.memoryId(), buffer.memoryId());
         if((error = clEnqueueCopyImageToBuffer(_id, image.memoryId(),
                 buffer.memoryId(), rect.origin(), rect.region(), offset,
-                cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncCopyImageToBuffer() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, image.memoryId(), buffer.memoryId());
     }
 
     Event CommandQueue::asyncCopyBufferToImage(const clw::Buffer& buffer,
@@ -422,14 +675,16 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, buffer.memoryId(), image.memoryId());
         if((error = clEnqueueCopyBufferToImage(_id, buffer.memoryId(),
                 image.memoryId(), offset, rect.origin(), rect.region(), 
-                cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+                cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncCopyBufferToImage() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, buffer.memoryId(), image.memoryId());
     }
 
     void* CommandQueue::mapBuffer(Buffer& buffer, 
@@ -438,8 +693,10 @@ namespace clw
                                   MapAccessFlags access)
     {
         cl_int error;
+        EventList wait;
+        appendHazards(wait, buffer.memoryId(), detail::mapWrites(access, buffer));
         void* data = clEnqueueMapBuffer(_id, buffer.memoryId(), CL_TRUE,
-            access.raw(), offset, size, 0, nullptr, nullptr, &error);
+            access.raw(), offset, size, cl_uint(wait.size()), wait, nullptr, &error);
         detail::reportError("CommandQueue::mapBuffer() ", error);
         return data;
     }
@@ -458,14 +715,17 @@ namespace clw
     {
         cl_int error;
         cl_event event;
+        EventList deps;
+        const cl_mem write = detail::mapWrites(access, buffer);
+        const EventList& wait = waitList(after, deps, buffer.memoryId(), write);
         *data = clEnqueueMapBuffer(_id, buffer.memoryId(), CL_FALSE,
-            access.raw(), offset, size, cl_uint(after.size()), after, &event, &error);
+            access.raw(), offset, size, cl_uint(wait.size()), wait, &event, &error);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncMapBuffer() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, buffer.memoryId(), write);
     }
 
     Event CommandQueue::asyncMapBuffer(Buffer& buffer, 
@@ -482,9 +742,11 @@ namespace clw
     {
         cl_int error;
         size_t pitch;
+        EventList wait;
+        appendHazards(wait, image.memoryId(), detail::mapWrites(access, image));
         void* data = clEnqueueMapImage(_id, image.memoryId(), CL_TRUE,
             access.raw(), rect.origin(), rect.region(), &pitch, nullptr,
-            0, nullptr, nullptr, &error);
+            cl_uint(wait.size()), wait, nullptr, &error);
         detail::reportError("CommandQueue::mapImage2D() ", error);
         return data;
     }
@@ -498,23 +760,28 @@ namespace clw
         cl_int error;
         cl_event event;
         size_t pitch;
+        EventList deps;
+        const cl_mem write = detail::mapWrites(access, image);
+        const EventList& wait = waitList(after, deps, image.memoryId(), write);
         *data = clEnqueueMapImage(_id, image.memoryId(), CL_FALSE,
             access.raw(), rect.origin(), rect.region(), &pitch, nullptr,
-            cl_uint(after.size()), after, &event, &error);
+            cl_uint(wait.size()), wait, &event, &error);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncMapImage2D() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, image.memoryId(), write);
     }
 
     bool CommandQueue::unmap(MemoryObject& obj, void* ptr)
     {
         cl_event event;
         cl_int error;
+        EventList wait;
+        appendHazards(wait, 0, obj.memoryId());
         if((error = clEnqueueUnmapMemObject(_id, obj.memoryId(),
-                ptr, 0, nullptr, &event)) != CL_SUCCESS)
+                ptr, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue()::unmap() ", error);
             return false;
@@ -533,18 +800,53 @@ namespace clw
     {
         cl_event event;
         cl_int error;
+        EventList deps;
+        // Whatever host wrote to mapped region becomes visible now
+        const EventList& wait = waitList(after, deps, 0, obj.memoryId());
         if((error = clEnqueueUnmapMemObject(_id, obj.memoryId(),
-            ptr, cl_uint(after.size()), after, &event)) != CL_SUCCESS)
+            ptr, cl_uint(wait.size()), wait, &event)) != CL_SUCCESS)
         {
             detail::reportError("CommandQueue()::asyncUnmap() ", error);
             return Event();
         }
         else
         {
-            return Event(event);
+            return track(event, 0, obj.memoryId());
         }
     }
 
+    Event CommandQueue::asyncFillBuffer(Buffer& buffer,
+                                        const void* pattern,
+                                        size_t patternSize,
+                                        size_t offset,
+                                        size_t size,
+                                        const EventList& after)
+    {
+#if defined(HAVE_OPENCL_1_2)
+        cl_int error;
+        cl_event event;
+        EventList deps;
+        const EventList& wait = waitList(after, deps, 0, buffer.memoryId());
+        if((error = clEnqueueFillBuffer(_id, buffer.memoryId(), pattern,
+                patternSize, offset, size, cl_uint(wait.size()), 
+                wait, &event)) != CL_SUCCESS)
+        {
+            detail::reportError("CommandQueue::asyncFillBuffer() ", error);
+            return Event();
+        }
+        return track(event, 0, buffer.memoryId());
+#else
+        (void) buffer;
+        (void) pattern;
+        (void) patternSize;
+        (void) offset;
+        (void) size;
+        (void) after;
+        detail::reportError("CommandQueue::asyncFillBuffer() ", CL_INVALID_OPERATION);
+        return Event();
+#endif
+    }
+
     bool CommandQueue::runKernel(const Kernel& kernel)
     {
 #if defined(HAVE_OPENCL_1_1)
@@ -559,11 +861,19 @@ namespace clw
         if(local.width() == 0)
             l = nullptr;
 
+        EventList wait;
+        if(_tracker)
+        {
+            vector<cl_mem> reads, writes;
+            kernel.boundMemoryObjects(&reads, &writes);
+            appendHazards(wait, reads, writes);
+        }
+
         cl_event event;
         cl_int error = clEnqueueNDRangeKernel
             (_id, kernel.kernelId(), 
             cl_uint(dims), offset, global, l,
-            0, nullptr, &event);
+            cl_uint(wait.size()), wait, &event);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::runKernel() ", error);
@@ -593,24 +903,42 @@ namespace clw
         if(local.width() == 0)
             l = nullptr;
 
+        EventList deps;
+        vector<cl_mem> reads, writes;
+        if(_tracker)
+        {
+            kernel.boundMemoryObjects(&reads, &writes);
+            deps = after;
+            appendHazards(deps, reads, writes);
+        }
+        const EventList& wait = _tracker ? deps : after;
+
         cl_event event;
         cl_int error = clEnqueueNDRangeKernel
             (_id, kernel.kernelId(), 
              cl_uint(dims), offset, global, l,
-             cl_uint(after.size()), after, &event);
+             cl_uint(wait.size()), wait, &event);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncRunKernel() ", error);
             return Event();
         }
-        return Event(event);
+        return track(event, reads, writes);
     }
 
     bool CommandQueue::runTask(const Kernel& kernel)
     {
+        EventList wait;
+        if(_tracker)
+        {
+            vector<cl_mem> reads, writes;
+            kernel.boundMemoryObjects(&reads, &writes);
+            appendHazards(wait, reads, writes);
+        }
+
         cl_event event;
         cl_int error = clEnqueueTask(_id, kernel.kernelId(),
-            0, nullptr, &event);
+            cl_uint(wait.size()), wait, &event);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::runTask() ", error);
@@ -626,14 +954,46 @@ namespace clw
     Event CommandQueue::asyncRunTask(const Kernel& kernel,
                                      const EventList& after)
     {
+        EventList deps;
+        vector<cl_mem> reads, writes;
+        if(_tracker)
+        {
+            kernel.boundMemoryObjects(&reads, &writes);
+            deps = after;
+            appendHazards(deps, reads, writes);
+        }
+        const EventList& wait = _tracker ? deps : after;
+
         cl_event event;
         cl_int error = clEnqueueTask(_id, kernel.kernelId(),
-            cl_uint(after.size()), after, &event);
+            cl_uint(wait.size()), wait, &event);
         if(error != CL_SUCCESS)
         {
             detail::reportError("CommandQueue::asyncRunTask() ", error);
             return Event();
         }
-        return Event();
+        return track(event, reads, writes);
+    }
+
+    Event CommandQueue::asyncMarker(const EventList& after)
+    {
+        cl_event event;
+        cl_int error;
+#if defined(HAVE_OPENCL_1_2)
+        error = clEnqueueMarkerWithWaitList(_id, 
+            cl_uint(after.size()), after, &event);
+#else
+        error = CL_SUCCESS;
+        if(!after.isEmpty())
+            error = clEnqueueWaitForEvents(_id, cl_uint(after.size()), after);
+        if(error == CL_SUCCESS)
+            error = clEnqueueMarker(_id, &event);
+#endif
+        if(error != CL_SUCCESS)
+        {
+            detail::reportError("CommandQueue::asyncMarker() ", error);
+            return Event();
+        }
+        return Event(event);
     }
 }
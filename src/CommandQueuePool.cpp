@@ -0,0 +1,188 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/CommandQueuePool.h"
+#include "clw/Context.h"
+#include "details.h"
+
+namespace clw
+{
+    CommandQueuePool::CommandQueuePool()
+        : _queuesPerDevice(0)
+        , _maxInFlight(0)
+        , _assignment(EQueueAssignment::RoundRobin)
+    {
+    }
+
+    CommandQueuePool::CommandQueuePool(Context& context,
+                                       size_t queuesPerDevice,
+                                       size_t maxInFlight,
+                                       EQueueAssignment assignment,
+                                       CommandQueueFlags properties)
+        : _queuesPerDevice(0)
+        , _maxInFlight(0)
+        , _assignment(EQueueAssignment::RoundRobin)
+    {
+        create(context, queuesPerDevice, maxInFlight, assignment, properties);
+    }
+
+    bool CommandQueuePool::create(Context& context,
+                                  size_t queuesPerDevice,
+                                  size_t maxInFlight,
+                                  EQueueAssignment assignment,
+                                  CommandQueueFlags properties)
+    {
+        _devices.clear();
+        if(!queuesPerDevice || !maxInFlight)
+        {
+            detail::reportError("CommandQueuePool::create(): ", CL_INVALID_VALUE);
+            return false;
+        }
+
+        for(const Device& device : context.devices())
+        {
+            std::unique_ptr<DeviceQueues> queues(new DeviceQueues());
+            queues->device = device;
+            for(size_t i = 0; i < queuesPerDevice; ++i)
+            {
+                std::unique_ptr<Slot> slot(new Slot());
+                slot->queue = context.createCommandQueue(device, properties);
+                if(slot->queue.isNull())
+                {
+                    _devices.clear();
+                    return false;
+                }
+                queues->slots.push_back(std::move(slot));
+            }
+            _devices.push_back(std::move(queues));
+        }
+        _queuesPerDevice = queuesPerDevice;
+        _maxInFlight = maxInFlight;
+        _assignment = assignment;
+        return !_devices.empty();
+    }
+
+    namespace detail
+    {
+        // Threads are spread over queues in order of their first call to
+        // any pool. Nothing is kept per thread id so short-lived threads 
+        // don't pile up
+        size_t threadQueueIndex()
+        {
+            static std::atomic<size_t> nextIndex(0);
+            static thread_local size_t index = nextIndex++;
+            return index;
+        }
+    }
+
+    CommandQueuePool::Slot* CommandQueuePool::pick(const Device& device)
+    {
+        DeviceQueues* queues = nullptr;
+        if(device.isNull())
+        {
+            queues = _devices.front().get();
+        }
+        else
+        {
+            for(auto& candidate : _devices)
+            {
+                if(candidate->device.deviceId() == device.deviceId())
+                {
+                    queues = candidate.get();
+                    break;
+                }
+            }
+            if(!queues)
+            {
+                detail::reportError("CommandQueuePool::pick(): ", CL_INVALID_DEVICE);
+                return nullptr;
+            }
+        }
+
+        const size_t index = _assignment == EQueueAssignment::PerThread
+            ? detail::threadQueueIndex()
+            : queues->next++;
+        return queues->slots[index % queues->slots.size()].get();
+    }
+
+    CommandQueue CommandQueuePool::acquire(const Device& device)
+    {
+        if(isNull())
+            return CommandQueue();
+        Slot* slot = pick(device);
+        return slot ? slot->queue : CommandQueue();
+    }
+
+    Event CommandQueuePool::submit(const QueueCommand& command,
+                                   const Device& device)
+    {
+        if(isNull())
+            return Event();
+        Slot* picked = pick(device);
+        if(!picked)
+            return Event();
+        Slot& slot = *picked;
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        while(!slot.inFlight.empty())
+        {
+            // Oldest command is (on in-order queue) the first to complete
+            Event& oldest = slot.inFlight.front();
+            if(oldest.status() > EEventStatus::Complete)
+            {
+                if(slot.inFlight.size() < _maxInFlight)
+                    break;
+                oldest.waitForFinished();
+            }
+            slot.inFlight.pop_front();
+        }
+        Event event = command(slot.queue);
+        if(!event.isNull())
+        {
+            slot.inFlight.push_back(event);
+            // Keep device busy while we may be blocked on the limit
+            slot.queue.flush();
+        }
+        return event;
+    }
+
+    void CommandQueuePool::flush()
+    {
+        for(auto& queues : _devices)
+        {
+            for(auto& slot : queues->slots)
+                slot->queue.flush();
+        }
+    }
+
+    void CommandQueuePool::finish()
+    {
+        for(auto& queues : _devices)
+        {
+            for(auto& slot : queues->slots)
+            {
+                std::lock_guard<std::mutex> lock(slot->mutex);
+                slot->queue.finish();
+                slot->inFlight.clear();
+            }
+        }
+    }
+}
@@ -0,0 +1,208 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/CommandSubmitter.h"
+#include "BoundedQueue.h"
+#include "details.h"
+
+namespace clw
+{
+    CommandSubmitter::CommandSubmitter()
+        : _posted(0)
+        , _processed(0)
+        , _posting(0)
+        , _sleeping(false)
+        , _stopping(false)
+        , _running(false)
+    {
+    }
+
+    CommandSubmitter::CommandSubmitter(const CommandQueue& queue, 
+                                       size_t capacity)
+        : _posted(0)
+        , _processed(0)
+        , _posting(0)
+        , _sleeping(false)
+        , _stopping(false)
+        , _running(false)
+    {
+        start(queue, capacity);
+    }
+
+    CommandSubmitter::~CommandSubmitter()
+    {
+        stop();
+    }
+
+    bool CommandSubmitter::start(const CommandQueue& queue, size_t capacity)
+    {
+        stop();
+        if(queue.isNull() || !capacity)
+            return false;
+        _queue = queue;
+        _commands.reset(new detail::BoundedQueue<SubmitterCommand>(capacity));
+        _posted = 0;
+        _processed = 0;
+        _posting = 0;
+        _sleeping = false;
+        _stopping = false;
+        _thread = std::thread(&CommandSubmitter::run, this);
+        _running = true;
+        return true;
+    }
+
+    void CommandSubmitter::stop()
+    {
+        if(!_thread.joinable())
+            return;
+        _running = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeup.notify_one();
+        _thread.join();
+        _queue.flush();
+    }
+
+    bool CommandSubmitter::tryPost(SubmitterCommand command)
+    {
+        if(!isRunning())
+            return false;
+        // Announced before checking _stopping so run() can't exit while 
+        // the command is on its way to the queue
+        ++_posting;
+        if(_stopping || !_commands->tryPush(std::move(command)))
+        {
+            --_posting;
+            return false;
+        }
+        ++_posted;
+        --_posting;
+        wake();
+        return true;
+    }
+
+    bool CommandSubmitter::post(SubmitterCommand command)
+    {
+        if(!isRunning())
+            return false;
+        ++_posting;
+        if(_stopping)
+        {
+            --_posting;
+            return false;
+        }
+        while(!_commands->tryPush(std::move(command)))
+            std::this_thread::yield();
+        ++_posted;
+        --_posting;
+        wake();
+        return true;
+    }
+
+    std::future<Event> CommandSubmitter::submit(function<Event(CommandQueue& queue)> command)
+    {
+        // std::function needs copyable callable
+        auto promise = std::make_shared<std::promise<Event>>();
+        std::future<Event> result = promise->get_future();
+        const bool posted = post([promise, command](CommandQueue& queue) {
+            try
+            {
+                promise->set_value(command(queue));
+            }
+            catch(...)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        if(!posted)
+        {
+            detail::reportError("CommandSubmitter::submit(): ", CL_INVALID_OPERATION);
+            promise->set_value(Event());
+        }
+        return result;
+    }
+
+    void CommandSubmitter::drain()
+    {
+        if(!isRunning())
+            return;
+        const uint64_t target = _posted;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _drained.wait(lock, [&] { return _processed >= target; });
+    }
+
+    void CommandSubmitter::wake()
+    {
+        // Mutex is taken only if submitter might be going to sleep so the
+        // notification can't get lost between its check and wait
+        if(_sleeping)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _wakeup.notify_one();
+        }
+    }
+
+    void CommandSubmitter::run()
+    {
+        SubmitterCommand command;
+        bool stopping = false;
+        for(;;)
+        {
+            if(_commands->tryPop(command))
+            {
+                try
+                {
+                    command(_queue);
+                }
+                catch(...)
+                {
+                    detail::reportError("CommandSubmitter::run(): ", CL_INVALID_OPERATION);
+                }
+                command = SubmitterCommand();
+                ++_processed;
+                continue;
+            }
+
+            // Nothing left for now, let the device start and anyone 
+            // waiting in drain() know
+            _queue.flush();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _drained.notify_all();
+            if(stopping)
+                break;
+            // No producer can get past _stopping check anymore - once the 
+            // ones already past it are done, drain the queue one last time
+            if(_stopping && _posting == 0)
+            {
+                stopping = true;
+                continue;
+            }
+            _sleeping = true;
+            _wakeup.wait(lock, [this] { 
+                return _processed != _posted || _stopping; 
+            });
+            _sleeping = false;
+        }
+    }
+}
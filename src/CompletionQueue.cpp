@@ -0,0 +1,233 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/CompletionQueue.h"
+#include "BoundedQueue.h"
+#include "details.h"
+
+namespace clw
+{
+    namespace detail
+    {
+        struct CompletionNode
+        {
+            CompletionQueue* owner;
+            Event event;
+            CompletionHandler handler;
+            cl_int status;
+        };
+
+        void deliverCompletion(CompletionNode* node)
+        {
+            node->owner->push(node);
+        }
+
+        void CL_CALLBACK completionNotify(cl_event event, 
+                                          cl_int status, 
+                                          void* userData)
+        {
+            (void) event;
+            CompletionNode* node = static_cast<CompletionNode*>(userData);
+            node->status = status;
+            deliverCompletion(node);
+        }
+    }
+
+    CompletionQueue::CompletionQueue()
+        : _overflowSize(0)
+        , _readyCount(0)
+        , _pending(0)
+        , _sleeping(0)
+        , _stopping(false)
+    {
+    }
+
+    CompletionQueue::CompletionQueue(size_t numWorkers, size_t capacity)
+        : _overflowSize(0)
+        , _readyCount(0)
+        , _pending(0)
+        , _sleeping(0)
+        , _stopping(false)
+    {
+        start(numWorkers, capacity);
+    }
+
+    CompletionQueue::~CompletionQueue()
+    {
+        stop();
+    }
+
+    bool CompletionQueue::start(size_t numWorkers, size_t capacity)
+    {
+        stop();
+        if(!numWorkers || !capacity)
+        {
+            detail::reportError("CompletionQueue::start(): ", CL_INVALID_VALUE);
+            return false;
+        }
+        _ready.reset(new detail::BoundedQueue<detail::CompletionNode*>(capacity));
+        _stopping = false;
+        for(size_t i = 0; i < numWorkers; ++i)
+            _workers.push_back(std::thread(&CompletionQueue::work, this));
+        return true;
+    }
+
+    void CompletionQueue::stop()
+    {
+        if(_workers.empty())
+            return;
+        if(isWorkerThread())
+        {
+            // Would wait for (and join) itself
+            detail::reportError("CompletionQueue::stop(): ", CL_INVALID_OPERATION);
+            return;
+        }
+        // Driver still holds pointers to nodes of pending events
+        waitForIdle();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeup.notify_all();
+        for(std::thread& worker : _workers)
+            worker.join();
+        _workers.clear();
+    }
+
+    bool CompletionQueue::watch(const Event& event, CompletionHandler handler)
+    {
+        if(!isRunning() || event.isNull())
+            return false;
+        detail::CompletionNode* node = new detail::CompletionNode();
+        node->owner = this;
+        node->event = event;
+        node->handler = std::move(handler);
+        node->status = CL_COMPLETE;
+        ++_pending;
+        cl_int error;
+        if((error = clSetEventCallback(event.eventId(), CL_COMPLETE, 
+                &detail::completionNotify, node)) != CL_SUCCESS)
+        {
+            detail::reportError("CompletionQueue::watch(): ", error);
+            delete node;
+            if(--_pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _idle.notify_all();
+            }
+            return false;
+        }
+        return true;
+    }
+
+    void CompletionQueue::waitForIdle()
+    {
+        if(isWorkerThread())
+        {
+            detail::reportError("CompletionQueue::waitForIdle(): ", CL_INVALID_OPERATION);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle.wait(lock, [this] { return _pending == 0; });
+    }
+
+    void CompletionQueue::push(detail::CompletionNode* node)
+    {
+        // Never block driver's thread, spill to the locked list instead
+        if(!_ready->tryPush(std::move(node)))
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _overflow.push_back(node);
+            ++_overflowSize;
+        }
+        ++_readyCount;
+        if(_sleeping)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _wakeup.notify_one();
+        }
+    }
+
+    detail::CompletionNode* CompletionQueue::next()
+    {
+        detail::CompletionNode* node = nullptr;
+        if(_ready->tryPop(node))
+            return node;
+        if(_overflowSize)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!_overflow.empty())
+            {
+                node = _overflow.front();
+                _overflow.pop_front();
+                --_overflowSize;
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    bool CompletionQueue::isWorkerThread() const
+    {
+        const std::thread::id id = std::this_thread::get_id();
+        for(const std::thread& worker : _workers)
+        {
+            if(worker.get_id() == id)
+                return true;
+        }
+        return false;
+    }
+
+    void CompletionQueue::work()
+    {
+        for(;;)
+        {
+            if(detail::CompletionNode* node = next())
+            {
+                --_readyCount;
+                try
+                {
+                    node->handler(node->event, node->status < 0 
+                        ? EEventStatus::Errored : EEventStatus::Complete);
+                }
+                catch(...)
+                {
+                    detail::reportError("CompletionQueue::work(): ", CL_INVALID_OPERATION);
+                }
+                delete node;
+                if(--_pending == 0)
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    _idle.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_stopping)
+                break;
+            ++_sleeping;
+            _wakeup.wait(lock, [this] { return _readyCount > 0 || _stopping; });
+            --_sleeping;
+        }
+    }
+}
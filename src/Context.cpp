@@ -24,6 +24,8 @@
 #include "clw/Platform.h"
 #include "clw/CommandQueue.h"
 #include "clw/Program.h"
+#include "clw/ProgramCache.h"
+#include "clw/ProgramBundle.h"
 #include "clw/Buffer.h"
 #include "clw/Image.h"
 #include "details.h"
@@ -125,10 +127,17 @@ namespace clw
 
         static ErrorHandler reportErrorHandler;
 
+        cl_int& threadLastError()
+        {
+            static thread_local cl_int error = CL_SUCCESS;
+            return error;
+        }
+
         void reportError(const char* name, cl_int _eid)
         {
             if(_eid != CL_SUCCESS)
             {
+                threadLastError() = _eid;
                 if(reportErrorHandler)
                     reportErrorHandler(_eid, string(name) + errorName(_eid));
                 else
@@ -169,10 +178,20 @@ namespace clw
         detail::reportErrorHandler = handler;
     }
 
+    cl_int lastError()
+    {
+        return detail::threadLastError();
+    }
+
+    void setLastError(cl_int error)
+    {
+        detail::threadLastError() = error;
+    }
+
     Context::Context() 
         : _id(0)
         , _isCreated(false)
-        , _eid(CL_SUCCESS)
+        , _programCache(nullptr)
     {
     }
 
@@ -184,7 +203,8 @@ namespace clw
 
     Context::Context(const Context& other)
         : _id(other._id), _isCreated(other._isCreated),
-        _eid(other._eid), _devs(other._devs)
+        _devs(other._devs),
+        _programCache(other._programCache)
     {
         if(_id)
             clRetainContext(_id);
@@ -198,15 +218,15 @@ namespace clw
             clReleaseContext(_id);
         _id = other._id;
         _isCreated = other._isCreated;
-        _eid = other._eid;
         _devs = other._devs;
+        _programCache = other._programCache;
         return *this;
     }
 
     Context::Context(Context&& other)
         : _id(0)
         , _isCreated(false)
-        , _eid(CL_SUCCESS)
+        , _programCache(nullptr)
     {
         *this = std::move(other);
     }
@@ -219,8 +239,8 @@ namespace clw
                 clReleaseContext(_id);
             _id = other._id;
             _isCreated = other._isCreated;
-            _eid = other._eid;
             _devs = std::move(other._devs);
+            _programCache = other._programCache;
             other._id = 0;
         }
         return *this;
@@ -228,6 +248,7 @@ namespace clw
 
     bool Context::create(EDeviceType type)
     {
+        cl_int& eid = detail::threadLastError();
         if(_isCreated)
             return true;
         vector<Platform> pls = clw::availablePlatforms();
@@ -243,14 +264,14 @@ namespace clw
                     0
                 };
                 if((_id = clCreateContext(props, 1, &did, 
-                        &detail::contextNotify, nullptr, &_eid)) != 0)
+                        &detail::contextNotify, nullptr, &eid)) != 0)
                 {
                     _devs.clear();
                     _devs.push_back(Device(did));
                     _isCreated = true;
                     return true;
                 }
-                detail::reportError("Context::create(type): ", _eid);
+                detail::reportError("Context::create(type): ", eid);
             }
         }
         _isCreated = false;
@@ -259,6 +280,7 @@ namespace clw
 
     bool Context::create(const vector<Device>& devices)
     {
+        cl_int& eid = detail::threadLastError();
         if(_isCreated)
             return true;
         if(devices.empty())
@@ -273,10 +295,10 @@ namespace clw
             0
         };
         if((_id = clCreateContext(props, cl_uint(dids.size()), dids.data(), 
-                &detail::contextNotify, nullptr, &_eid)) != 0)
+                &detail::contextNotify, nullptr, &eid)) != 0)
         {
             size_t size;
-            if((_eid = clGetContextInfo(_id, CL_CONTEXT_DEVICES, 0,
+            if((eid = clGetContextInfo(_id, CL_CONTEXT_DEVICES, 0,
                     nullptr, &size)) == CL_SUCCESS)
             {
                 // !FIXME: assert(size == dids.size())
@@ -285,12 +307,13 @@ namespace clw
                 return true;
             }			
         }
-        detail::reportError("Context::create(devices): ", _eid);
+        detail::reportError("Context::create(devices): ", eid);
         return false;
     }
 
     bool Context::createOffline(const Platform& platform)
     {
+        cl_int& eid = detail::threadLastError();
         if(_isCreated)
             return true;
         cl_platform_id plid = platform.platformId();
@@ -304,12 +327,12 @@ namespace clw
             0
         };
         _id = clCreateContextFromType
-            (props, CL_DEVICE_TYPE_ALL, nullptr, nullptr, &_eid);
-        detail::reportError("Context::createOffline(devices): ", _eid);
-        if(_eid == CL_SUCCESS)
+            (props, CL_DEVICE_TYPE_ALL, nullptr, nullptr, &eid);
+        detail::reportError("Context::createOffline(devices): ", eid);
+        if(eid == CL_SUCCESS)
         {
             size_t size;
-            if((_eid = clGetContextInfo(_id, CL_CONTEXT_DEVICES, 0,
+            if((eid = clGetContextInfo(_id, CL_CONTEXT_DEVICES, 0,
                     nullptr, &size)) == CL_SUCCESS)
             {
                 size_t numDevices = size / sizeof(cl_device_id);
@@ -350,10 +373,11 @@ namespace clw
     CommandQueue Context::createCommandQueue(const Device& device,
                                              CommandQueueFlags properties)
     {
+        cl_int& eid = detail::threadLastError();
         cl_command_queue cid = clCreateCommandQueue
             (_id, device.deviceId(),
-            properties.raw(), &_eid);
-        detail::reportError("Context::createCommandQueue(): ", _eid);
+            properties.raw(), &eid);
+        detail::reportError("Context::createCommandQueue(): ", eid);
         return cid ? CommandQueue(this, cid) : CommandQueue();
     }
 
@@ -362,13 +386,14 @@ namespace clw
                                  size_t size,
                                  const void* data)
     {
+        cl_int& eid = detail::threadLastError();
         cl_mem_flags mem_flags = cl_mem_flags(access);
         if(data && location != EMemoryLocation::UseHostMemory)
             mem_flags |= CL_MEM_COPY_HOST_PTR;
         mem_flags |= cl_mem_flags(location);
         cl_mem bid = clCreateBuffer
-            (_id, mem_flags, size, const_cast<void*>(data), &_eid);
-        detail::reportError("Context::createBuffer(): ", _eid);
+            (_id, mem_flags, size, const_cast<void*>(data), &eid);
+        detail::reportError("Context::createBuffer(): ", eid);
         return bid ? Buffer(this, bid) : Buffer();
     }
 
@@ -379,6 +404,7 @@ namespace clw
                                    size_t height,
                                    const void* data)
     {
+        cl_int& eid = detail::threadLastError();
         cl_image_format image_format;
         image_format.image_channel_order = cl_channel_order(format.order);
         image_format.image_channel_data_type = cl_channel_type(format.type);
@@ -400,14 +426,14 @@ namespace clw
         desc.buffer = nullptr;
         cl_mem iid = clCreateImage
             (_id, mem_flags, &image_format,
-             &desc, const_cast<void*>(data), &_eid);
+             &desc, const_cast<void*>(data), &eid);
 #else
 
         cl_mem iid = clCreateImage2D
             (_id, mem_flags, &image_format, 
-             width, height, 0, const_cast<void*>(data), &_eid);
+             width, height, 0, const_cast<void*>(data), &eid);
 #endif
-        detail::reportError("Context::createImage2D(): ", _eid);
+        detail::reportError("Context::createImage2D(): ", eid);
         return iid ? Image2D(this, iid) : Image2D();
     }
 
@@ -415,20 +441,22 @@ namespace clw
                                    EAddressingMode addressingMode, 
                                    EFilterMode filterMode)
     {
+        cl_int& eid = detail::threadLastError();
         cl_sampler sampler = clCreateSampler
             (_id, normalizedCoords ? CL_TRUE : CL_FALSE, 
              cl_addressing_mode(addressingMode), 
-             cl_filter_mode(filterMode), &_eid);
-        detail::reportError("Context::createSampler() ", _eid);
+             cl_filter_mode(filterMode), &eid);
+        detail::reportError("Context::createSampler() ", eid);
         return sampler ? Sampler(this, sampler) : Sampler();
     }
 
 
     UserEvent Context::createUserEvent()
     {
+        cl_int& eid = detail::threadLastError();
 #if defined(HAVE_OPENCL_1_1)
-        cl_event event = clCreateUserEvent(_id, &_eid);
-        detail::reportError("Context::createUserEvent() ", _eid);
+        cl_event event = clCreateUserEvent(_id, &eid);
+        detail::reportError("Context::createUserEvent() ", eid);
         return UserEvent(event);
 #else
         return UserEvent();
@@ -447,10 +475,11 @@ namespace clw
 
     Program Context::createProgramFromSourceCode(const string& sourceCode)
     {
+        cl_int& eid = detail::threadLastError();
         size_t length = sourceCode.length();
         const char* code = sourceCode.c_str();
-        cl_program pid = clCreateProgramWithSource(_id, 1, &code, &length, &_eid);
-        detail::reportError("Context::createProgramFromSourceCode(): ", _eid);
+        cl_program pid = clCreateProgramWithSource(_id, 1, &code, &length, &eid);
+        detail::reportError("Context::createProgramFromSourceCode(): ", eid);
         return pid ? Program(this, pid) : Program();
     }
 
@@ -465,6 +494,8 @@ namespace clw
     Program Context::buildProgramFromSourceCode(const string& sourceCode,
                                                 const string& options)
     {
+        if(_programCache)
+            return _programCache->buildProgramFromSourceCode(*this, sourceCode, options);
         Program program = createProgramFromSourceCode(sourceCode);
         if(program.isNull() || program.build(options))
             return program;
@@ -474,9 +505,112 @@ namespace clw
     Program Context::buildProgramFromSourceFile(const string& fileName,
                                                 const string& options)
     {
+        if(_programCache)
+            return _programCache->buildProgramFromSourceFile(*this, fileName, options);
         Program program = createProgramFromSourceFile(fileName);
         if(program.isNull() || program.build(options))
             return program;
         return Program();
     }
+
+    Program Context::linkPrograms(const vector<Program>& programs,
+                                  const string& options)
+    {
+#if defined(HAVE_OPENCL_1_2)
+        cl_int& eid = detail::threadLastError();
+        if(programs.empty())
+        {
+            detail::reportError("Context::linkPrograms(): ", CL_INVALID_VALUE);
+            return Program();
+        }
+        vector<cl_program> pids(programs.size());
+        for(size_t i = 0; i < programs.size(); ++i)
+            pids[i] = programs[i].programId();
+        cl_program pid = clLinkProgram(_id, 0, nullptr, options.c_str(), 
+            cl_uint(pids.size()), pids.data(), nullptr, nullptr, &eid);
+        detail::reportError("Context::linkPrograms(): ", eid);
+        if(!pid)
+            return Program();
+        Program program(this, pid);
+        if(eid != CL_SUCCESS)
+            return Program();
+        program._built = true;
+        program._options = options;
+        return program;
+#else
+        (void) programs;
+        (void) options;
+        detail::reportError("Context::linkPrograms(): ", CL_INVALID_OPERATION);
+        return Program();
+#endif
+    }
+
+    Program Context::createProgramFromBinaries(const vector<Device>& devices,
+                                               const vector<ByteCode>& binaries)
+    {
+        cl_int& eid = detail::threadLastError();
+        if(devices.empty() || devices.size() != binaries.size())
+        {
+            detail::reportError("Context::createProgramFromBinaries(): ", CL_INVALID_VALUE);
+            return Program();
+        }
+        vector<cl_device_id> dids(devices.size());
+        vector<size_t> lengths(devices.size());
+        vector<const unsigned char*> bins(devices.size());
+        for(size_t i = 0; i < devices.size(); ++i)
+        {
+            dids[i] = devices[i].deviceId();
+            lengths[i] = binaries[i].size();
+            bins[i] = binaries[i].data();
+        }
+        vector<cl_int> status(devices.size());
+        cl_program pid = clCreateProgramWithBinary(_id, cl_uint(dids.size()),
+            dids.data(), lengths.data(), bins.data(), status.data(), &eid);
+        detail::reportError("Context::createProgramFromBinaries(): ", eid);
+        return pid ? Program(this, pid) : Program();
+    }
+
+    Program Context::createProgramFromBinary(const Device& device,
+                                             const ByteCode& binary)
+    {
+        return createProgramFromBinaries(vector<Device>(1, device), 
+                                         vector<ByteCode>(1, binary));
+    }
+
+    Program Context::buildProgramFromBundle(const ProgramBundle& bundle,
+                                            const string& fallbackSourceCode)
+    {
+        vector<ByteCode> bins;
+        for(const Device& device : _devs)
+        {
+            const ByteCode* bin = bundle.findBinary(device);
+            if(!bin)
+                break;
+            bins.push_back(*bin);
+        }
+
+        if(!_devs.empty() && bins.size() == _devs.size())
+        {
+            Program program = createProgramFromBinaries(_devs, bins);
+            if(!program.isNull() && program.build(bundle.buildOptions()))
+                return program;
+        }
+
+        if(fallbackSourceCode.empty())
+            return Program();
+        return buildProgramFromSourceCode(fallbackSourceCode, bundle.buildOptions());
+    }
+
+    Program Context::buildProgramFromBundleFile(const string& fileName,
+                                                const string& fallbackSourceFile)
+    {
+        ProgramBundle bundle;
+        string sourceCode;
+        // Missing or broken bundle is not an error as long as there are sources
+        bundle.load(fileName);
+        if(!fallbackSourceFile.empty() && 
+                !detail::readAsString(fallbackSourceFile, &sourceCode))
+            sourceCode.clear();
+        return buildProgramFromBundle(bundle, sourceCode);
+    }
 }
@@ -79,6 +79,93 @@ namespace clw
         {
             return string(deviceInfoVector<char>(id, info).data());
         }
+
+        vector<Device> createSubDevices(cl_device_id id, const intptr_t* props)
+        {
+#if defined(HAVE_OPENCL_1_2)
+            cl_uint num;
+            cl_int error = CL_SUCCESS;
+            if(!id || (error = clCreateSubDevices(id, props, 
+                    0, nullptr, &num)) != CL_SUCCESS)
+            {
+                reportError("Device::partition(): ", error);
+                return vector<Device>();
+            }
+            vector<cl_device_id> ids(num);
+            if((error = clCreateSubDevices(id, props, 
+                    num, ids.data(), nullptr)) != CL_SUCCESS)
+            {
+                reportError("Device::partition(): ", error);
+                return vector<Device>();
+            }
+            vector<Device> devices(num);
+            for(cl_uint i = 0; i < num; ++i)
+            {
+                // Adopt reference returned by clCreateSubDevices
+                devices[i]._id = ids[i];
+                devices[i]._owned = true;
+            }
+            return devices;
+#else
+            (void) id;
+            (void) props;
+            reportError("Device::partition(): ", CL_INVALID_OPERATION);
+            return vector<Device>();
+#endif
+        }
+    }
+
+    Device::~Device()
+    {
+#if defined(HAVE_OPENCL_1_2)
+        if(_owned)
+            clReleaseDevice(_id);
+#endif
+    }
+
+    Device::Device(const Device& other)
+        : _id(other._id), _owned(other._owned)
+    {
+#if defined(HAVE_OPENCL_1_2)
+        if(_owned)
+            clRetainDevice(_id);
+#endif
+    }
+
+    Device& Device::operator=(const Device& other)
+    {
+#if defined(HAVE_OPENCL_1_2)
+        if(other._owned)
+            clRetainDevice(other._id);
+        if(_owned)
+            clReleaseDevice(_id);
+#endif
+        _id = other._id;
+        _owned = other._owned;
+        return *this;
+    }
+
+    Device::Device(Device&& other)
+        : _id(other._id), _owned(other._owned)
+    {
+        other._id = 0;
+        other._owned = false;
+    }
+
+    Device& Device::operator=(Device&& other)
+    {
+        if(&other != this)
+        {
+#if defined(HAVE_OPENCL_1_2)
+            if(_owned)
+                clReleaseDevice(_id);
+#endif
+            _id = other._id;
+            _owned = other._owned;
+            other._id = 0;
+            other._owned = false;
+        }
+        return *this;
     }
 
     EDeviceType Device::deviceType() const
@@ -620,4 +707,73 @@ namespace clw
     {
         return detail::deviceInfo<bool>(_id, CL_DEVICE_INTEGRATED_MEMORY_NV);
     }
+
+    vector<Device> Device::partitionEqually(int computeUnitsPerDevice) const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        const cl_device_partition_property props[] = {
+            CL_DEVICE_PARTITION_EQUALLY,
+            cl_device_partition_property(computeUnitsPerDevice),
+            0
+        };
+        return detail::createSubDevices(_id, props);
+#else
+        (void) computeUnitsPerDevice;
+        return detail::createSubDevices(_id, nullptr);
+#endif
+    }
+
+    vector<Device> Device::partitionByCounts(const vector<int>& computeUnits) const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        vector<cl_device_partition_property> props;
+        props.push_back(CL_DEVICE_PARTITION_BY_COUNTS);
+        for(int count : computeUnits)
+            props.push_back(cl_device_partition_property(count));
+        props.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+        props.push_back(0);
+        return detail::createSubDevices(_id, props.data());
+#else
+        (void) computeUnits;
+        return detail::createSubDevices(_id, nullptr);
+#endif
+    }
+
+    vector<Device> Device::partitionByAffinityDomain(EAffinityDomain domain) const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        const cl_device_partition_property props[] = {
+            CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN,
+            cl_device_partition_property(domain),
+            0
+        };
+        return detail::createSubDevices(_id, props);
+#else
+        (void) domain;
+        return detail::createSubDevices(_id, nullptr);
+#endif
+    }
+
+    bool Device::isSubDevice() const
+    {
+        return !parentDevice().isNull();
+    }
+
+    Device Device::parentDevice() const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        return Device(detail::deviceInfo<cl_device_id>(_id, CL_DEVICE_PARENT_DEVICE));
+#else
+        return Device();
+#endif
+    }
+
+    int Device::maximumSubDevices() const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        return int(detail::deviceInfo<cl_uint>(_id, CL_DEVICE_PARTITION_MAX_SUB_DEVICES));
+#else
+        return 0;
+#endif
+    }
 }
@@ -21,6 +21,7 @@
 */
 
 #include "clw/Event.h"
+#include "BoundedQueue.h"
 #include "details.h"
 
 #include <algorithm>
@@ -61,8 +62,58 @@ namespace clw
                                        void *user_data)
         {
             (void) event;
-            EventCallback* pfn = static_cast<EventCallback*>(user_data);
-            (*pfn)(EEventStatus(event_command_exec_status));
+            EventCallbackNode* node = static_cast<EventCallbackNode*>(user_data);
+            // Negative statuses are errors
+            const EEventStatus status = event_command_exec_status < 0 
+                ? EEventStatus::Errored
+                : EEventStatus(event_command_exec_status);
+            // Exception must not reach driver's thread
+            try
+            {
+                node->invoke(node, &status);
+            }
+            catch(...)
+            {
+                reportError("Event::setCallback(): ", CL_INVALID_OPERATION);
+            }
+            releaseCallbackNode(node);
+        }
+
+        // Free nodes, nodes released when it's full are deleted
+        BoundedQueue<EventCallbackNode*>& callbackNodePool()
+        {
+            static BoundedQueue<EventCallbackNode*> pool(4096);
+            return pool;
+        }
+
+        EventCallbackNode* acquireCallbackNode()
+        {
+            EventCallbackNode* node;
+            if(callbackNodePool().tryPop(node))
+                return node;
+            return new EventCallbackNode();
+        }
+
+        void releaseCallbackNode(EventCallbackNode* node)
+        {
+            if(!callbackNodePool().tryPush(std::move(node)))
+                delete node;
+        }
+
+        bool attachCallbackNode(cl_event id, cl_int status, 
+                                EventCallbackNode* node)
+        {
+            cl_int error = CL_INVALID_EVENT;
+            if(!id || (error = clSetEventCallback(id, status, 
+                    &callback_priv, node)) != CL_SUCCESS)
+            {
+                reportError("Event::setCallback(): ", error);
+                // Destroy callable without calling it
+                node->invoke(node, nullptr);
+                releaseCallbackNode(node);
+                return false;
+            }
+            return true;
         }
     }
 
@@ -73,7 +124,7 @@ namespace clw
     }
 
     Event::Event(const Event& other)
-        : _id(other._id), _callback(other._callback)
+        : _id(other._id)
     {
         if(_id)
             clRetainEvent(_id);
@@ -86,7 +137,6 @@ namespace clw
         if(_id)
             clReleaseEvent(_id);
         _id = other._id;
-        _callback = other._callback;
         return *this;
     }
 
@@ -103,7 +153,6 @@ namespace clw
             if (_id)
                 clReleaseEvent(_id);
             _id = other._id;
-            _callback = std::move(other._callback);
             other._id = 0;
         }
         return *this;
@@ -121,13 +170,6 @@ namespace clw
             (_id, CL_EVENT_COMMAND_TYPE));
     }
 
-    void Event::setCallback(EEventStatus status, EventCallback cb)
-    {
-        _callback = std::move(cb);
-        clSetEventCallback(_id, cl_int(status), 
-            &detail::callback_priv, &_callback);
-    }
-
     void Event::waitForFinished()
     {
         if(_id)
@@ -176,7 +218,6 @@ namespace clw
         if(_id)
             clReleaseEvent(_id);
         _id = other._id;
-        _callback = other._callback;
         return *this;
     }
 
@@ -193,7 +234,6 @@ namespace clw
             if (_id)
                 clReleaseEvent(_id);
             _id = other._id;
-            _callback = std::move(other._callback);
             other._id = 0;
         }
         return *this;
@@ -98,6 +98,122 @@ namespace clw
         }
 #endif
 
+        struct KernelArgCache
+        {
+            struct Argument
+            {
+                Argument() 
+                    : isSet(false), size(0), isMemoryObject(false)
+                    , readOnly(false), declaredReadOnly(-1), retained(0) {}
+
+                bool isSet;
+                size_t size;
+                // Empty for local memory arguments
+                vector<unsigned char> bytes;
+                // Set by setArg(unsigned, cl_mem) for current value
+                bool isMemoryObject;
+                bool readOnly;
+                // Cached from argument info: -1 unknown, 0 or 1 otherwise
+                int declaredReadOnly;
+                // Memory object set by setArg(unsigned, cl_mem), retained 
+                // while it's in the shadow so its handle can't be reused
+                cl_mem retained;
+            };
+
+            ~KernelArgCache()
+            {
+                for(Argument& arg : args)
+                    release(arg);
+            }
+
+            static void release(Argument& arg)
+            {
+                if(arg.retained)
+                {
+                    clReleaseMemObject(arg.retained);
+                    arg.retained = 0;
+                }
+            }
+
+            bool matches(unsigned index, const void* data, size_t size) const
+            {
+                if(index >= args.size() || !args[index].isSet)
+                    return false;
+                const Argument& arg = args[index];
+                if(arg.size != size || arg.bytes.empty() != (data == nullptr))
+                    return false;
+                return !data || memcmp(arg.bytes.data(), data, size) == 0;
+            }
+
+            void store(unsigned index, const void* data, size_t size)
+            {
+                if(index >= args.size())
+                    args.resize(index + 1);
+                Argument& arg = args[index];
+                release(arg);
+                arg.isSet = true;
+                arg.size = size;
+                arg.isMemoryObject = false;
+                if(data)
+                {
+                    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                    arg.bytes.assign(bytes, bytes + size);
+                }
+                else
+                {
+                    arg.bytes.clear();
+                }
+            }
+
+            void forget(unsigned index)
+            {
+                if(index < args.size())
+                {
+                    args[index].isSet = false;
+                    release(args[index]);
+                }
+            }
+
+            vector<Argument> args;
+            KernelArgumentStatistics statistics;
+        };
+
+        // Whether kernel argument is declared as something kernel can't 
+        // write to. Queried directly as argument info is often missing.
+        bool isArgumentDeclaredReadOnly(cl_kernel id, cl_uint index)
+        {
+#if defined(HAVE_OPENCL_1_2)
+            cl_kernel_arg_address_qualifier address;
+            if(clGetKernelArgInfo(id, index, CL_KERNEL_ARG_ADDRESS_QUALIFIER, 
+                    sizeof(address), &address, nullptr) != CL_SUCCESS)
+                return false;
+            if(address == CL_KERNEL_ARG_ADDRESS_CONSTANT)
+                return true;
+            cl_kernel_arg_access_qualifier access;
+            if(clGetKernelArgInfo(id, index, CL_KERNEL_ARG_ACCESS_QUALIFIER, 
+                    sizeof(access), &access, nullptr) == CL_SUCCESS &&
+                    access == CL_KERNEL_ARG_ACCESS_READ_ONLY)
+                return true;
+            cl_kernel_arg_type_qualifier type;
+            return clGetKernelArgInfo(id, index, CL_KERNEL_ARG_TYPE_QUALIFIER, 
+                    sizeof(type), &type, nullptr) == CL_SUCCESS &&
+                (type & CL_KERNEL_ARG_TYPE_CONST) != 0;
+#else
+            (void) id;
+            (void) index;
+            return false;
+#endif
+        }
+    }
+
+    Kernel::Kernel(Context* ctx, cl_kernel id)
+        : _ctx(ctx)
+        , _id(id)
+        , _globalWorkOffset(0)
+        , _globalWorkSize(1)
+        , _localWorkSize(0)
+        , _args(id ? std::make_shared<detail::KernelArgCache>() : nullptr)
+    {
     }
 
     Kernel::~Kernel()
@@ -112,6 +228,7 @@ namespace clw
         , _globalWorkOffset(other._globalWorkOffset)
         , _globalWorkSize(other._globalWorkSize)
         , _localWorkSize(other._localWorkSize)
+        , _args(other._args)
     {
         if(_id)
             clRetainKernel(_id);
@@ -128,6 +245,7 @@ namespace clw
         _globalWorkOffset = other._globalWorkOffset;
         _globalWorkSize = other._globalWorkSize;
         _localWorkSize = other._localWorkSize;
+        _args = other._args;
         return *this;
     }
 
@@ -152,6 +270,7 @@ namespace clw
             _globalWorkOffset = std::move(other._globalWorkOffset);
             _globalWorkSize = std::move(other._globalWorkSize);
             _localWorkSize = std::move(other._localWorkSize);
+            _args = std::move(other._args);
             other._ctx = nullptr;
             other._id = 0;
         }
@@ -232,6 +351,18 @@ namespace clw
             (_id, device.deviceId(), CL_KERNEL_PRIVATE_MEM_SIZE));
     }
 
+    bool Kernel::hasArgumentInfo() const
+    {
+#if defined(HAVE_OPENCL_1_2)
+        // Queried directly so missing info doesn't get reported as an error
+        size_t size;
+        return _id && argCount() > 0 && clGetKernelArgInfo(_id, 0, 
+            CL_KERNEL_ARG_TYPE_NAME, 0, nullptr, &size) == CL_SUCCESS;
+#else
+        return false;
+#endif
+    }
+
     EKernelArgumentAddressQualifier Kernel::argumentAddressQualifier(int index) const
     {
 #if defined(HAVE_OPENCL_1_2)
@@ -289,8 +420,133 @@ namespace clw
 
     void Kernel::setArg(unsigned index, const void* data, size_t size)
     {
+        if(_args && _args->matches(index, data, size))
+        {
+            ++_args->statistics.skipped;
+            return;
+        }
         cl_int error = clSetKernelArg(_id, index, size, data);
         detail::reportError("Kernel::setArg(): ", error);
+        if(!_args)
+            return;
+        ++_args->statistics.set;
+        if(error == CL_SUCCESS)
+            _args->store(index, data, size);
+        else
+            _args->forget(index);
+    }
+
+    void Kernel::setArg(unsigned index, cl_mem memObject)
+    {
+        // Compared by retained handle rather than raw bytes - a released
+        // object's handle value may have been given to a new allocation
+        if(_args && index < _args->args.size())
+        {
+            const detail::KernelArgCache::Argument& arg = _args->args[index];
+            if(arg.isSet && arg.isMemoryObject && arg.retained == memObject)
+            {
+                ++_args->statistics.skipped;
+                return;
+            }
+        }
+        cl_int error = clSetKernelArg(_id, index, sizeof(cl_mem), &memObject);
+        detail::reportError("Kernel::setArg(): ", error);
+        if(!_args)
+            return;
+        ++_args->statistics.set;
+        if(error != CL_SUCCESS)
+        {
+            _args->forget(index);
+            return;
+        }
+
+        _args->store(index, &memObject, sizeof(cl_mem));
+        detail::KernelArgCache::Argument& arg = _args->args[index];
+        arg.isMemoryObject = true;
+        arg.readOnly = false;
+        if(memObject)
+        {
+            clRetainMemObject(memObject);
+            arg.retained = memObject;
+        }
+        cl_mem_flags flags;
+        if(memObject && clGetMemObjectInfo(memObject, CL_MEM_FLAGS, 
+                sizeof(flags), &flags, nullptr) == CL_SUCCESS)
+            arg.readOnly = (flags & CL_MEM_READ_ONLY) != 0;
+        if(!arg.readOnly)
+        {
+            if(arg.declaredReadOnly < 0)
+                arg.declaredReadOnly = detail::isArgumentDeclaredReadOnly(_id, index);
+            arg.readOnly = arg.declaredReadOnly != 0;
+        }
+    }
+
+    void Kernel::boundMemoryObjects(vector<cl_mem>* reads, 
+                                    vector<cl_mem>* writes) const
+    {
+        if(!_args)
+            return;
+        for(const auto& arg : _args->args)
+        {
+            if(!arg.isSet || !arg.isMemoryObject || arg.size != sizeof(cl_mem))
+                continue;
+            cl_mem mem;
+            memcpy(&mem, arg.bytes.data(), sizeof(cl_mem));
+            if(!mem)
+                continue;
+            vector<cl_mem>* list = arg.readOnly ? reads : writes;
+            if(list)
+                list->push_back(mem);
+        }
+    }
+
+    KernelArgumentValues Kernel::arguments() const
+    {
+        KernelArgumentValues values;
+        if(!_args)
+            return values;
+        values.resize(_args->args.size());
+        for(size_t i = 0; i < values.size(); ++i)
+        {
+            const detail::KernelArgCache::Argument& arg = _args->args[i];
+            values[i].isSet = arg.isSet;
+            values[i].isMemoryObject = arg.isMemoryObject;
+            values[i].size = arg.size;
+            values[i].bytes = arg.bytes;
+        }
+        return values;
+    }
+
+    void Kernel::setArguments(const KernelArgumentValues& values)
+    {
+        for(size_t i = 0; i < values.size(); ++i)
+        {
+            const KernelArgumentValue& value = values[i];
+            if(!value.isSet)
+                continue;
+            if(value.isMemoryObject && value.size == sizeof(cl_mem))
+            {
+                cl_mem mem;
+                memcpy(&mem, value.bytes.data(), sizeof(cl_mem));
+                setArg(unsigned(i), mem);
+            }
+            else
+            {
+                setArg(unsigned(i), value.bytes.empty() 
+                    ? nullptr : value.bytes.data(), value.size);
+            }
+        }
+    }
+
+    KernelArgumentStatistics Kernel::argumentStatistics() const
+    {
+        return _args ? _args->statistics : KernelArgumentStatistics();
+    }
+
+    void Kernel::resetArgumentStatistics()
+    {
+        if(_args)
+            _args->statistics = KernelArgumentStatistics();
     }
 
     clw::Event Kernel::operator()(CommandQueue& queue)
@@ -0,0 +1,218 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/KernelVariantCache.h"
+#include "clw/Context.h"
+
+namespace clw
+{
+    KernelVariantCache::KernelVariantCache(Context* context,
+                                           const string& sourceCode,
+                                           const string& baseOptions,
+                                           uint64_t memoryBudget)
+        : _ctx(context)
+        , _sourceCode(sourceCode)
+        , _baseOptions(baseOptions)
+        , _memoryBudget(memoryBudget)
+        , _memoryUsage(0)
+        , _hits(0)
+        , _misses(0)
+    {
+    }
+
+    Kernel KernelVariantCache::kernel(const string& name, 
+                                      const KernelDefines& defines)
+    {
+        Program prog = program(defines);
+        if(prog.isNull())
+            return Kernel();
+
+        const string options = buildOptions(_baseOptions, defines);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Variant* variant = findVariant(options);
+            if(variant)
+            {
+                auto it = variant->kernels.find(name);
+                if(it != variant->kernels.end())
+                    return it->second;
+            }
+        }
+
+        Kernel kernel = prog.createKernel(name);
+        if(kernel.isNull())
+            return Kernel();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Variant could have been evicted in the meantime - just don't cache
+        Variant* variant = findVariant(options);
+        if(!variant)
+            return kernel;
+        return variant->kernels.insert(std::make_pair(name, kernel)).first->second;
+    }
+
+    Program KernelVariantCache::program(const KernelDefines& defines)
+    {
+        if(!_ctx)
+            return Program();
+
+        const string options = buildOptions(_baseOptions, defines);
+        std::promise<Program> building;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            Variant* variant = findVariant(options);
+            if(variant)
+            {
+                ++_hits;
+                return variant->program;
+            }
+            auto it = _building.find(options);
+            if(it != _building.end())
+            {
+                // Someone else is already building it - wait for their result
+                std::shared_future<Program> result = it->second;
+                ++_hits;
+                lock.unlock();
+                return result.get();
+            }
+            ++_misses;
+            _building[options] = building.get_future().share();
+        }
+
+        // Build without holding the lock so other variants can be served 
+        // (and built) in the meantime
+        Program prog = _ctx->buildProgramFromSourceCode(_sourceCode, options);
+        if(prog.isNull() || !prog.isBuilt())
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _building.erase(options);
+            }
+            building.set_value(Program());
+            return Program();
+        }
+
+        uint64_t size = 0;
+        for(size_t binSize : prog.binarySizes())
+            size += binSize;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _building.erase(options);
+        building.set_value(prog);
+
+        _lru.push_front(options);
+        Variant& newVariant = _variants[options];
+        newVariant.program = prog;
+        newVariant.size = size;
+        newVariant.lru = _lru.begin();
+        _memoryUsage += size;
+        evict();
+        return prog;
+    }
+
+    bool KernelVariantCache::contains(const KernelDefines& defines) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _variants.find(buildOptions(_baseOptions, defines)) != _variants.end();
+    }
+
+    uint64_t KernelVariantCache::memoryBudget() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _memoryBudget;
+    }
+
+    void KernelVariantCache::setMemoryBudget(uint64_t memoryBudget)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _memoryBudget = memoryBudget;
+        evict();
+    }
+
+    uint64_t KernelVariantCache::memoryUsage() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _memoryUsage;
+    }
+
+    size_t KernelVariantCache::numVariants() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _variants.size();
+    }
+
+    void KernelVariantCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _variants.clear();
+        _lru.clear();
+        _memoryUsage = 0;
+    }
+
+    uint64_t KernelVariantCache::hits() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _hits;
+    }
+
+    uint64_t KernelVariantCache::misses() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _misses;
+    }
+
+    string KernelVariantCache::buildOptions(const string& baseOptions,
+                                            const KernelDefines& defines)
+    {
+        // std::map keeps defines sorted so equal sets give equal strings
+        string options = baseOptions;
+        for(const auto& define : defines)
+        {
+            if(!options.empty())
+                options += ' ';
+            options += "-D" + define.first;
+            if(!define.second.empty())
+                options += "=" + define.second;
+        }
+        return options;
+    }
+
+    KernelVariantCache::Variant* KernelVariantCache::findVariant(const string& options)
+    {
+        auto it = _variants.find(options);
+        if(it == _variants.end())
+            return nullptr;
+        _lru.splice(_lru.begin(), _lru, it->second.lru);
+        return &it->second;
+    }
+
+    void KernelVariantCache::evict()
+    {
+        while(_memoryUsage > _memoryBudget && _lru.size() > 1)
+        {
+            auto it = _variants.find(_lru.back());
+            _memoryUsage -= it->second.size;
+            _variants.erase(it);
+            _lru.pop_back();
+        }
+    }
+}
@@ -0,0 +1,337 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/MultiDeviceDispatcher.h"
+#include "clw/Context.h"
+#include "details.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace clw
+{
+    namespace detail
+    {
+        Grid replaceLastDimension(const Grid& grid, size_t value)
+        {
+            switch(grid.dimensions())
+            {
+            case 1: return Grid(value);
+            case 2: return Grid(grid.width(), value);
+            default: return Grid(grid.width(), grid.height(), value);
+            }
+        }
+
+        // Offset of the slice with the same dimensions as global grid
+        Grid sliceOffset(const Grid& base, const Grid& global, size_t begin)
+        {
+            size_t offset[3];
+            for(cl_uint i = 0; i < 3; ++i)
+                offset[i] = i < base.dimensions() ? base[i] : 0;
+            offset[global.dimensions() - 1] += begin;
+            switch(global.dimensions())
+            {
+            case 1: return Grid(offset[0]);
+            case 2: return Grid(offset[0], offset[1]);
+            default: return Grid(offset[0], offset[1], offset[2]);
+            }
+        }
+    }
+
+    MultiDeviceDispatcher::MultiDeviceDispatcher()
+        : _ctx(nullptr)
+    {
+    }
+
+    MultiDeviceDispatcher::MultiDeviceDispatcher(Context& context,
+                                                 const vector<Device>& devices)
+        : _ctx(nullptr)
+    {
+        create(context, devices);
+    }
+
+    bool MultiDeviceDispatcher::create(Context& context, 
+                                       const vector<Device>& devices)
+    {
+        _ctx = nullptr;
+        _devices.clear();
+        _queues.clear();
+        _ratios.clear();
+        _slices.clear();
+        _kernelEvents.clear();
+
+#if !defined(HAVE_OPENCL_1_1)
+        // Slices are launched with global work offset
+        (void) context;
+        (void) devices;
+        detail::reportError("MultiDeviceDispatcher::create(): ", CL_INVALID_OPERATION);
+        return false;
+#else
+        const vector<Device>& devs = devices.empty() ? context.devices() : devices;
+        if(devs.empty())
+            return false;
+        for(const Device& device : devs)
+        {
+            CommandQueue queue = context.createCommandQueue(device, 
+                ECommandQueueProperty::ProfilingEnabled);
+            if(queue.isNull())
+            {
+                _devices.clear();
+                _queues.clear();
+                return false;
+            }
+            _devices.push_back(device);
+            _queues.push_back(std::move(queue));
+        }
+        _ctx = &context;
+        _ratios.assign(_devices.size(), 1.0 / double(_devices.size()));
+        return true;
+#endif
+    }
+
+    void MultiDeviceDispatcher::setRatios(const vector<double>& ratios)
+    {
+        const double sum = std::accumulate(ratios.begin(), ratios.end(), 0.0);
+        if(ratios.size() != _ratios.size() || sum <= 0.0 ||
+            std::any_of(ratios.begin(), ratios.end(), 
+                [](double ratio) { return ratio < 0.0; }))
+        {
+            detail::reportError("MultiDeviceDispatcher::setRatios(): ", CL_INVALID_VALUE);
+            return;
+        }
+        for(size_t i = 0; i < ratios.size(); ++i)
+            _ratios[i] = ratios[i] / sum;
+    }
+
+    const vector<DispatchSlice>& MultiDeviceDispatcher::plan(const Grid& global, 
+                                                              const Grid& local)
+    {
+        _slices.clear();
+        _global = global;
+        if(isNull())
+            return _slices;
+
+        const cl_uint last = global.dimensions() - 1;
+        const size_t extent = global[last];
+        size_t granularity = 1;
+        if(local.width() != 0 && last < local.dimensions() && local[last] != 0)
+            granularity = local[last];
+        const size_t units = (extent + granularity - 1) / granularity;
+
+        // Largest remainder method so units add up exactly
+        vector<size_t> counts(_ratios.size());
+        vector<std::pair<double, size_t>> remainders;
+        size_t assigned = 0;
+        for(size_t i = 0; i < _ratios.size(); ++i)
+        {
+            const double exact = _ratios[i] * double(units);
+            counts[i] = std::min(units - assigned, size_t(std::floor(exact)));
+            assigned += counts[i];
+            remainders.push_back(std::make_pair(exact - double(counts[i]), i));
+        }
+        std::sort(remainders.begin(), remainders.end(), 
+            [](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b) {
+                return a.first > b.first;
+            });
+        for(size_t i = 0; assigned < units; i = (i + 1) % remainders.size())
+        {
+            ++counts[remainders[i].second];
+            ++assigned;
+        }
+
+        size_t begin = 0;
+        for(size_t i = 0; i < counts.size(); ++i)
+        {
+            if(!counts[i])
+                continue;
+            const size_t end = std::min(extent, begin + counts[i] * granularity);
+            _slices.push_back(DispatchSlice(i, begin, end));
+            begin = end;
+        }
+        return _slices;
+    }
+
+    vector<Buffer> MultiDeviceDispatcher::createBuffers(EAccess access, 
+                                                        EMemoryLocation location, 
+                                                        size_t size)
+    {
+        vector<Buffer> buffers;
+        if(!_ctx)
+            return buffers;
+        for(size_t i = 0; i < _devices.size(); ++i)
+        {
+            Buffer buffer = _ctx->createBuffer(access, location, size);
+            if(buffer.isNull())
+                return vector<Buffer>();
+            buffers.push_back(std::move(buffer));
+        }
+        return buffers;
+    }
+
+    EventList MultiDeviceDispatcher::scatter(vector<Buffer>& buffers,
+                                             const void* data,
+                                             size_t bytesPerSlice,
+                                             size_t halo,
+                                             const EventList& after)
+    {
+        EventList events;
+        if(buffers.size() != _queues.size())
+        {
+            detail::reportError("MultiDeviceDispatcher::scatter(): ", CL_INVALID_VALUE);
+            return events;
+        }
+        const size_t extent = _global[_global.dimensions() - 1];
+        for(const DispatchSlice& slice : _slices)
+        {
+            const size_t begin = slice.begin > halo ? slice.begin - halo : 0;
+            const size_t end = std::min(extent, slice.end + halo);
+            const size_t offset = begin * bytesPerSlice;
+            CommandQueue& queue = _queues[slice.device];
+            Event event = queue.asyncWriteBuffer(buffers[slice.device], 
+                static_cast<const char*>(data) + offset, offset, 
+                (end - begin) * bytesPerSlice, after);
+            if(!event.isNull())
+                events.append(event);
+            queue.flush();
+        }
+        return events;
+    }
+
+    EventList MultiDeviceDispatcher::broadcast(vector<Buffer>& buffers,
+                                               const void* data,
+                                               size_t size,
+                                               const EventList& after)
+    {
+        EventList events;
+        if(buffers.size() != _queues.size())
+        {
+            detail::reportError("MultiDeviceDispatcher::broadcast(): ", CL_INVALID_VALUE);
+            return events;
+        }
+        for(size_t i = 0; i < _queues.size(); ++i)
+        {
+            Event event = _queues[i].asyncWriteBuffer(buffers[i], data, 0, size, after);
+            if(!event.isNull())
+                events.append(event);
+            _queues[i].flush();
+        }
+        return events;
+    }
+
+    EventList MultiDeviceDispatcher::gather(const vector<Buffer>& buffers,
+                                            void* data,
+                                            size_t bytesPerSlice,
+                                            const EventList& after)
+    {
+        EventList events;
+        if(buffers.size() != _queues.size())
+        {
+            detail::reportError("MultiDeviceDispatcher::gather(): ", CL_INVALID_VALUE);
+            return events;
+        }
+        for(const DispatchSlice& slice : _slices)
+        {
+            const size_t offset = slice.begin * bytesPerSlice;
+            CommandQueue& queue = _queues[slice.device];
+            Event event = queue.asyncReadBuffer(buffers[slice.device], 
+                static_cast<char*>(data) + offset, offset, 
+                slice.size() * bytesPerSlice, after);
+            if(!event.isNull())
+                events.append(event);
+            queue.flush();
+        }
+        return events;
+    }
+
+    EventList MultiDeviceDispatcher::run(const Kernel& kernel,
+                                         const DispatchArgumentBinder& binder,
+                                         const EventList& after)
+    {
+        EventList events;
+        _kernelEvents.clear();
+        for(const DispatchSlice& slice : _slices)
+        {
+            // Copy shares cl_kernel whose arguments are captured at enqueue 
+            Kernel part(kernel);
+            part.setGlobalWorkSize(detail::replaceLastDimension(_global, slice.size()));
+            part.setGlobalWorkOffset(detail::sliceOffset(
+                kernel.globalWorkOffset(), _global, slice.begin));
+            if(binder)
+                binder(part, slice.device);
+            CommandQueue& queue = _queues[slice.device];
+            Event event = queue.asyncRunKernel(part, after);
+            queue.flush();
+            if(event.isNull())
+                continue;
+            events.append(event);
+            _kernelEvents.push_back(event);
+        }
+        return events;
+    }
+
+    void MultiDeviceDispatcher::finish()
+    {
+        for(CommandQueue& queue : _queues)
+            queue.finish();
+    }
+
+    bool MultiDeviceDispatcher::rebalance(double smoothing)
+    {
+        if(_kernelEvents.empty() || _kernelEvents.size() != _slices.size())
+            return false;
+
+        vector<double> throughput(_ratios.size(), 0.0);
+        double measuredSum = 0.0;
+        size_t measured = 0;
+        for(size_t i = 0; i < _slices.size(); ++i)
+        {
+            Event& event = _kernelEvents[i];
+            event.waitForFinished();
+            const uint64_t start = event.startTime();
+            const uint64_t end = event.finishTime();
+            if(end <= start)
+                continue;
+            const size_t device = _slices[i].device;
+            throughput[device] = double(_slices[i].size()) / double(end - start);
+            measuredSum += throughput[device];
+            ++measured;
+        }
+        _kernelEvents.clear();
+        if(!measured)
+            return false;
+
+        // Devices without a slice get average throughput so they're tried again
+        const double average = measuredSum / double(measured);
+        double sum = 0.0;
+        for(double& value : throughput)
+        {
+            if(value == 0.0)
+                value = average;
+            sum += value;
+        }
+        smoothing = std::max(0.0, std::min(1.0, smoothing));
+        for(size_t i = 0; i < _ratios.size(); ++i)
+            _ratios[i] = (1.0 - smoothing) * _ratios[i] + smoothing * throughput[i] / sum;
+        return true;
+    }
+}
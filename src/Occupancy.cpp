@@ -0,0 +1,222 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/Occupancy.h"
+#include "clw/Kernel.h"
+#include "clw/Device.h"
+#include "clw/WorkSizeTuner.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace clw
+{
+    namespace detail
+    {
+        // Per compute unit hardware limits
+        struct ComputeUnitLimits
+        {
+            ComputeUnitLimits()
+                : simdWidth(1)
+                , maxWavefronts(0)
+                , maxGroups(0)
+                , localMemory(0)
+                , registers(0)
+            {}
+
+            size_t simdWidth;
+            // 0 if unknown
+            int maxWavefronts;
+            int maxGroups;
+            uint64_t localMemory;
+            // Registers available to single work-group (NVIDIA)
+            int registers;
+        };
+
+        ComputeUnitLimits computeUnitLimits(const Kernel& kernel, const Device& device)
+        {
+            ComputeUnitLimits limits;
+            limits.localMemory = device.localMemorySize();
+
+            if(device.supportsExtension("cl_nv_device_attribute_query"))
+            {
+                const int major = device.computeCapabilityMajor();
+                limits.simdWidth = size_t(std::max(device.warpSize(), 1));
+                limits.maxWavefronts = major >= 3 ? 64 : major == 2 ? 48 : 32;
+                limits.maxGroups = major >= 5 ? 32 : major >= 3 ? 16 : 8;
+                limits.registers = device.registersPerBlock();
+            }
+            else if(device.supportsExtension("cl_amd_device_attribute_query"))
+            {
+                limits.simdWidth = size_t(std::max(device.wavefrontWidth(), 1));
+                // GCN: up to 10 wavefronts per SIMD and 16 work-groups per CU
+                limits.maxWavefronts = std::max(device.simdPerComputeUnit(), 1) * 10;
+                limits.maxGroups = 16;
+                const int localMemory = device.localMemorySizePerComputeUnit();
+                if(localMemory > 0)
+                    limits.localMemory = uint64_t(localMemory);
+            }
+            else if(device.deviceType() == EDeviceType::Cpu)
+            {
+                // CPU runtimes execute one work-group per hardware thread
+                limits.maxGroups = 1;
+            }
+            else
+            {
+                limits.simdWidth = size_t(std::max(
+                    kernel.preferredMultipleWorkGroupSize(device), 1));
+            }
+            return limits;
+        }
+
+        size_t gridSize(const Grid& grid)
+        {
+            size_t size = 1;
+            for(cl_uint d = 0; d < grid.dimensions(); ++d)
+                size *= grid[d];
+            return size;
+        }
+    }
+
+    OccupancyEstimate estimateOccupancy(const Kernel& kernel,
+                                        const Device& device,
+                                        const Grid& localSize,
+                                        uint64_t dynamicLocalMemory)
+    {
+        OccupancyEstimate estimate;
+        if(kernel.isNull() || device.isNull())
+            return estimate;
+
+        const detail::ComputeUnitLimits limits = 
+            detail::computeUnitLimits(kernel, device);
+        const size_t kernelMaxGroup = size_t(kernel.maximumWorkItemsPerGroup(device));
+
+        estimate.workGroupSize = detail::gridSize(localSize);
+        estimate.simdWidth = limits.simdWidth;
+        estimate.wavefrontsPerGroup = int((estimate.workGroupSize + 
+            limits.simdWidth - 1) / limits.simdWidth);
+        estimate.maximumWavefrontsPerComputeUnit = limits.maxWavefronts;
+        estimate.localMemoryPerGroup = kernel.localMemoryUsage(device) + 
+            dynamicLocalMemory;
+
+        if(estimate.workGroupSize == 0 || 
+                estimate.workGroupSize > kernelMaxGroup ||
+                estimate.workGroupSize > device.maximumWorkItemsPerGroup() ||
+                estimate.localMemoryPerGroup > limits.localMemory)
+        {
+            estimate.limit = estimate.localMemoryPerGroup > limits.localMemory ?
+                EOccupancyLimit::LocalMemory : EOccupancyLimit::WorkGroupSize;
+            return estimate;
+        }
+
+        // Start with the weakest bound and tighten it with every resource
+        int groups = std::numeric_limits<int>::max();
+        EOccupancyLimit limit = EOccupancyLimit::None;
+        auto tighten = [&](uint64_t bound, EOccupancyLimit reason)
+        {
+            if(bound < uint64_t(groups))
+            {
+                groups = int(bound);
+                limit = reason;
+            }
+        };
+
+        if(limits.maxGroups > 0)
+            tighten(uint64_t(limits.maxGroups), EOccupancyLimit::WorkGroupSlots);
+        if(limits.maxWavefronts > 0)
+        {
+            tighten(uint64_t(limits.maxWavefronts / estimate.wavefrontsPerGroup),
+                EOccupancyLimit::WavefrontSlots);
+        }
+        if(estimate.localMemoryPerGroup > 0)
+        {
+            tighten(limits.localMemory / estimate.localMemoryPerGroup,
+                EOccupancyLimit::LocalMemory);
+        }
+        if(limits.registers > 0 && kernelMaxGroup > 0 &&
+                kernelMaxGroup < device.maximumWorkItemsPerGroup())
+        {
+            // Kernel's maximum work-group size is lowered by register pressure
+            // so registers per work-item can be derived from it
+            const uint64_t registersPerItem = 
+                std::max<uint64_t>(uint64_t(limits.registers) / kernelMaxGroup, 1);
+            tighten(uint64_t(limits.registers) / 
+                (registersPerItem * estimate.workGroupSize), EOccupancyLimit::Registers);
+        }
+        // No information at all - assume single resident work-group
+        if(groups == std::numeric_limits<int>::max())
+            groups = 1;
+
+        estimate.groupsPerComputeUnit = groups;
+        estimate.wavefrontsPerComputeUnit = groups * estimate.wavefrontsPerGroup;
+        estimate.limit = limit;
+        if(limits.maxWavefronts > 0)
+        {
+            estimate.occupancy = std::min(1.0f, 
+                float(estimate.wavefrontsPerComputeUnit) / limits.maxWavefronts);
+        }
+        else
+        {
+            estimate.occupancy = groups > 0 ? 1.0f : 0.0f;
+        }
+        return estimate;
+    }
+
+    Grid recommendLocalWorkSize(const Kernel& kernel,
+                                const Device& device,
+                                const Grid& globalSize,
+                                uint64_t localMemoryPerWorkItem)
+    {
+        Grid best(0);
+        float bestOccupancy = 0.0f;
+        size_t bestPadding = 0;
+        size_t bestGroupSize = 0;
+
+        const size_t globalItems = detail::gridSize(globalSize);
+        for(const Grid& candidate : 
+                WorkSizeTuner::candidates(kernel, device, globalSize))
+        {
+            const size_t groupSize = detail::gridSize(candidate);
+            if(groupSize == 0)
+                continue;
+            const OccupancyEstimate estimate = estimateOccupancy(kernel, 
+                device, candidate, localMemoryPerWorkItem * groupSize);
+            if(!estimate.isValid())
+                continue;
+
+            const size_t padding = detail::gridSize(
+                globalSize.roundTo(candidate)) - globalItems;
+            const bool better = bestGroupSize == 0 ||
+                estimate.occupancy > bestOccupancy ||
+                (estimate.occupancy == bestOccupancy && (padding < bestPadding ||
+                    (padding == bestPadding && groupSize > bestGroupSize)));
+            if(better)
+            {
+                best = candidate;
+                bestOccupancy = estimate.occupancy;
+                bestPadding = padding;
+                bestGroupSize = groupSize;
+            }
+        }
+        return best;
+    }
+}
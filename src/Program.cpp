@@ -25,14 +25,72 @@
 #include "clw/Kernel.h"
 #include "details.h"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 namespace clw
 {
     namespace detail
     {
+        bool queryBuildStatus(cl_program id)
+        {
+            cl_uint size;
+            if(clGetProgramInfo(id, CL_PROGRAM_NUM_DEVICES, 
+                    sizeof(cl_uint), &size, nullptr) != CL_SUCCESS || size == 0)
+                return false;
+            vector<cl_device_id> devs(size);
+            if(clGetProgramInfo(id, CL_PROGRAM_DEVICES, 
+                    sizeof(cl_device_id) * size, devs.data(), nullptr) != CL_SUCCESS)
+                return false;
+            for(cl_device_id dev : devs)
+            {
+                cl_build_status status;
+                if(clGetProgramBuildInfo(id, dev, CL_PROGRAM_BUILD_STATUS,
+                        sizeof(cl_build_status), &status, nullptr) != CL_SUCCESS ||
+                        status != CL_BUILD_SUCCESS)
+                    return false;
+#if defined(HAVE_OPENCL_1_2)
+                // Successfully compiled objects and libraries aren't executable
+                cl_program_binary_type type;
+                if(clGetProgramBuildInfo(id, dev, CL_PROGRAM_BINARY_TYPE,
+                        sizeof(cl_program_binary_type), &type, nullptr) != CL_SUCCESS ||
+                        type != CL_PROGRAM_BINARY_TYPE_EXECUTABLE)
+                    return false;
+#endif
+            }
+            return true;
+        }
+
+        // Shared between Program::buildAsync() and notify callback. Some 
+        // drivers invoke the callback before clBuildProgram() returns (and 
+        // still report build failure) so both sides hold a reference
+        struct AsyncBuildState
+        {
+            AsyncBuildState() : refs(2), fulfilled(false) {}
+
+            void fulfill(bool result)
+            {
+                if(!fulfilled.exchange(true))
+                    promise.set_value(result);
+            }
+
+            void release()
+            {
+                if(refs.fetch_sub(1) == 1)
+                    delete this;
+            }
+
+            std::promise<bool> promise;
+            std::atomic<int> refs;
+            std::atomic<bool> fulfilled;
+        };
+
         extern "C" void CL_API_CALL buildNotify(cl_program id, void* userData)
         {
-            (void) id;
-            (void) userData;
+            AsyncBuildState* state = static_cast<AsyncBuildState*>(userData);
+            state->fulfill(queryBuildStatus(id));
+            state->release();
         }
 
         template<typename Value>
@@ -126,6 +184,85 @@ namespace clw
         return _built;
     }
 
+    bool Program::isBuilt() const
+    {
+        // Remember success of buildAsync() (or build done through another
+        // copy) so it's queried from the driver only once
+        if(!_built && _id && detail::queryBuildStatus(_id))
+            _built = true;
+        return _built;
+    }
+
+    std::shared_future<bool> Program::buildAsync(string options)
+    {
+        detail::AsyncBuildState* state = new detail::AsyncBuildState();
+        std::shared_future<bool> future = state->promise.get_future().share();
+        if(!_ctx)
+        {
+            state->fulfill(false);
+            delete state;
+            return future;
+        }
+
+        _built = false;
+        _options = std::move(options);
+        cl_int error = clBuildProgram(_id, 0, nullptr, _options.c_str(),
+                                      &detail::buildNotify, state);
+        if(error == CL_SUCCESS)
+        {
+            state->release();
+        }
+        else if(error == CL_BUILD_PROGRAM_FAILURE)
+        {
+            // Callback may or may not have been called
+            state->fulfill(false);
+            state->release();
+        }
+        else
+        {
+            // Build hasn't started so callback will never be called
+            detail::reportError("Program::buildAsync(): ", error);
+            state->fulfill(false);
+            state->release();
+            state->release();
+        }
+        return future;
+    }
+
+    bool Program::compile(string options, const vector<Program>& headers,
+                          const vector<string>& headerNames)
+    {
+        if(!_ctx)
+            return false;
+#if defined(HAVE_OPENCL_1_2)
+        if(headers.size() != headerNames.size())
+        {
+            detail::reportError("Program::compile(): ", CL_INVALID_VALUE);
+            return false;
+        }
+        vector<cl_program> hids(headers.size());
+        vector<const char*> names(headers.size());
+        for(size_t i = 0; i < headers.size(); ++i)
+        {
+            hids[i] = headers[i].programId();
+            names[i] = headerNames[i].c_str();
+        }
+        cl_int error = clCompileProgram(_id, 0, nullptr, options.c_str(), 
+            cl_uint(hids.size()), hids.empty() ? nullptr : hids.data(),
+            names.empty() ? nullptr : names.data(), nullptr, nullptr);
+        detail::reportError("Program::compile(): ", error);
+        _built = false;
+        _options = std::move(options);
+        return error == CL_SUCCESS;
+#else
+        (void) options;
+        (void) headers;
+        (void) headerNames;
+        detail::reportError("Program::compile(): ", CL_INVALID_OPERATION);
+        return false;
+#endif
+    }
+
     string Program::log() const
     {
         vector<Device> devs = devices();
@@ -199,12 +336,9 @@ namespace clw
     vector<ByteCode> Program::binaries() const
     {
         vector<ByteCode> bins;
-        cl_uint size;
-        if((size = detail::programInfo<cl_uint>(_id, CL_PROGRAM_NUM_DEVICES)) == 0)
-            return bins;
-        vector<size_t> binSizes(size);
-        if(!detail::programInfo(_id, CL_PROGRAM_BINARY_SIZES,
-                binSizes.data(), size))
+        vector<size_t> binSizes = binarySizes();
+        size_t size = binSizes.size();
+        if(size == 0)
             return bins;
         vector<unsigned char*> binPtrs;
         for(size_t i = 0; i < size; ++i)
@@ -223,6 +357,18 @@ namespace clw
         return bins;
     }
 
+    vector<size_t> Program::binarySizes() const
+    {
+        cl_uint size;
+        if((size = detail::programInfo<cl_uint>(_id, CL_PROGRAM_NUM_DEVICES)) == 0)
+            return vector<size_t>();
+        vector<size_t> binSizes(size);
+        if(!detail::programInfo(_id, CL_PROGRAM_BINARY_SIZES,
+                binSizes.data(), size))
+            return vector<size_t>();
+        return binSizes;
+    }
+
     Kernel Program::createKernel(const char* name) const
     {
         cl_int error;
@@ -260,4 +406,32 @@ namespace clw
             vec.push_back(Kernel(_ctx, buf[i]));
         return vec;
     }
+
+    bool buildPrograms(vector<Program>& programs, const string& options,
+                       unsigned numThreads)
+    {
+        if(numThreads == 0)
+            numThreads = std::max(1U, std::thread::hardware_concurrency());
+        numThreads = unsigned(std::min<size_t>(numThreads, programs.size()));
+
+        std::atomic<size_t> next(0);
+        std::atomic<bool> success(true);
+        auto worker = [&]
+        {
+            size_t index;
+            while((index = next.fetch_add(1)) < programs.size())
+            {
+                if(!programs[index].build(options))
+                    success = false;
+            }
+        };
+
+        vector<std::thread> threads;
+        for(unsigned i = 1; i < numThreads; ++i)
+            threads.emplace_back(worker);
+        worker();
+        for(std::thread& thread : threads)
+            thread.join();
+        return success;
+    }
 }
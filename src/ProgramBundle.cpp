@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/ProgramBundle.h"
+#include "clw/Program.h"
+#include "clw/Device.h"
+#include "clw/Platform.h"
+#include "details.h"
+
+namespace clw
+{
+    namespace detail
+    {
+        static const char programBundleMagic[8] = { 'C','L','W','B','U','N','D','L' };
+        static const uint32_t programBundleVersion = 1;
+    }
+
+    DeviceFingerprint::DeviceFingerprint(const Device& device)
+        : name(device.name())
+        , vendor(device.vendor())
+        , driverVersion(device.driverVersion())
+        , deviceVersion(device.version())
+        , platformVersion(device.platform().versionString())
+    {
+    }
+
+    string DeviceFingerprint::toString() const
+    {
+        return name + "|" + vendor + "|" + driverVersion + "|" +
+            deviceVersion + "|" + platformVersion;
+    }
+
+    bool DeviceFingerprint::operator==(const DeviceFingerprint& other) const
+    {
+        return name == other.name &&
+            vendor == other.vendor &&
+            driverVersion == other.driverVersion &&
+            deviceVersion == other.deviceVersion &&
+            platformVersion == other.platformVersion;
+    }
+
+    ProgramBundle::ProgramBundle(const Program& program)
+    {
+        addProgram(program);
+    }
+
+    void ProgramBundle::addBinary(const DeviceFingerprint& fingerprint, 
+                                  const ByteCode& binary)
+    {
+        for(Entry& entry : _entries)
+        {
+            if(entry.fingerprint == fingerprint)
+            {
+                entry.binary = binary;
+                return;
+            }
+        }
+        Entry entry;
+        entry.fingerprint = fingerprint;
+        entry.binary = binary;
+        _entries.push_back(std::move(entry));
+    }
+
+    bool ProgramBundle::addProgram(const Program& program)
+    {
+        if(program.isNull() || !program.isBuilt())
+            return false;
+        vector<Device> devs = program.devices();
+        vector<ByteCode> bins = program.binaries();
+        if(devs.size() != bins.size())
+            return false;
+        for(size_t i = 0; i < devs.size(); ++i)
+        {
+            if(!bins[i].empty())
+                addBinary(DeviceFingerprint(devs[i]), bins[i]);
+        }
+        _options = program.buildOptions();
+        return true;
+    }
+
+    const ByteCode* ProgramBundle::findBinary(const DeviceFingerprint& fingerprint) const
+    {
+        for(const Entry& entry : _entries)
+        {
+            if(entry.fingerprint == fingerprint)
+                return &entry.binary;
+        }
+        return nullptr;
+    }
+
+    const ByteCode* ProgramBundle::findBinary(const Device& device) const
+    {
+        return findBinary(DeviceFingerprint(device));
+    }
+
+    ByteCode ProgramBundle::serialize() const
+    {
+        ByteCode data;
+        detail::appendBytes(data, detail::programBundleMagic, 
+            sizeof(detail::programBundleMagic));
+        detail::appendValue(data, detail::programBundleVersion);
+        detail::appendString(data, _options);
+        detail::appendValue(data, uint32_t(_entries.size()));
+        for(const Entry& entry : _entries)
+        {
+            detail::appendString(data, entry.fingerprint.name);
+            detail::appendString(data, entry.fingerprint.vendor);
+            detail::appendString(data, entry.fingerprint.driverVersion);
+            detail::appendString(data, entry.fingerprint.deviceVersion);
+            detail::appendString(data, entry.fingerprint.platformVersion);
+            detail::appendValue(data, uint64_t(entry.binary.size()));
+            detail::appendBytes(data, entry.binary.data(), entry.binary.size());
+        }
+        return data;
+    }
+
+    bool ProgramBundle::deserialize(const ByteCode& data)
+    {
+        size_t pos = 0;
+        char magic[sizeof(detail::programBundleMagic)];
+        uint32_t version, count;
+        string options;
+        if(!detail::extractValue(data, pos, &magic) ||
+                memcmp(magic, detail::programBundleMagic, sizeof(magic)) != 0 ||
+                !detail::extractValue(data, pos, &version) ||
+                version != detail::programBundleVersion ||
+                !detail::extractString(data, pos, &options) ||
+                !detail::extractValue(data, pos, &count))
+            return false;
+
+        // Five string lengths and a binary size - reject counts that can't
+        // possibly fit before allocating anything for them
+        const size_t minimumEntrySize = 5 * sizeof(uint32_t) + sizeof(uint64_t);
+        if(count > (data.size() - pos) / minimumEntrySize)
+            return false;
+
+        vector<Entry> entries(count);
+        for(Entry& entry : entries)
+        {
+            uint64_t size;
+            if(!detail::extractString(data, pos, &entry.fingerprint.name) ||
+                    !detail::extractString(data, pos, &entry.fingerprint.vendor) ||
+                    !detail::extractString(data, pos, &entry.fingerprint.driverVersion) ||
+                    !detail::extractString(data, pos, &entry.fingerprint.deviceVersion) ||
+                    !detail::extractString(data, pos, &entry.fingerprint.platformVersion) ||
+                    !detail::extractValue(data, pos, &size) ||
+                    data.size() - pos < size)
+                return false;
+            entry.binary.assign(data.begin() + pos, data.begin() + pos + size_t(size));
+            pos += size_t(size);
+        }
+
+        _options = std::move(options);
+        _entries = std::move(entries);
+        return true;
+    }
+
+    bool ProgramBundle::load(const string& fileName)
+    {
+        ByteCode data;
+        if(!detail::readAsBytes(fileName, &data))
+            return false;
+        return deserialize(data);
+    }
+
+    bool ProgramBundle::save(const string& fileName) const
+    {
+        ByteCode data = serialize();
+        return detail::writeAtomically(fileName, data.data(), data.size());
+    }
+}
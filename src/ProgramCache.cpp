@@ -0,0 +1,241 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/ProgramCache.h"
+#include "clw/Context.h"
+#include "clw/Program.h"
+#include "clw/Device.h"
+#include "clw/Platform.h"
+#include "clw/ProgramBundle.h"
+#include "details.h"
+
+#include <cstring>
+#include <cstdio>
+
+namespace clw
+{
+    namespace detail
+    {
+        static const char programCacheMagic[8] = { 'C','L','W','P','C','A','C','H' };
+        static const uint32_t programCacheVersion = 1;
+    }
+
+    ProgramCache::ProgramCache()
+        : _hits(0)
+        , _misses(0)
+    {
+    }
+
+    ProgramCache::ProgramCache(const string& directory)
+        : _hits(0)
+        , _misses(0)
+    {
+        setDirectory(directory);
+    }
+
+    bool ProgramCache::setDirectory(const string& directory)
+    {
+        _directory.clear();
+        if(directory.empty() || !detail::makeDirectory(directory))
+            return false;
+        _directory = directory;
+        char last = _directory[_directory.length() - 1];
+        if(last != '/' && last != '\\')
+            _directory += '/';
+        return true;
+    }
+
+    void ProgramCache::resetStatistics()
+    {
+        _hits = 0;
+        _misses = 0;
+    }
+
+    Program ProgramCache::buildProgramFromSourceCode(Context& context,
+                                                     const string& sourceCode,
+                                                     const string& options)
+    {
+        if(!isValid())
+        {
+            Program program = context.createProgramFromSourceCode(sourceCode);
+            if(program.isNull() || program.build(options))
+                return program;
+            return Program();
+        }
+
+        const string key = entryKey(context, sourceCode, options);
+        Program program = loadProgram(context, key, options);
+        if(!program.isNull())
+        {
+            ++_hits;
+            return program;
+        }
+
+        ++_misses;
+        program = context.createProgramFromSourceCode(sourceCode);
+        if(program.isNull())
+            return program;
+        if(!program.build(options))
+            return Program();
+        storeProgram(context, key, program);
+        return program;
+    }
+
+    Program ProgramCache::buildProgramFromSourceFile(Context& context,
+                                                     const string& fileName,
+                                                     const string& options)
+    {
+        string sourceCode;
+        if(!detail::readAsString(fileName, &sourceCode))
+            return Program();
+        return buildProgramFromSourceCode(context, sourceCode, options);
+    }
+
+    bool ProgramCache::remove(const Context& context,
+                              const string& sourceCode, 
+                              const string& options)
+    {
+        if(!isValid())
+            return false;
+        const string fileName = entryFileName(entryKey(context, sourceCode, options));
+        return std::remove(fileName.c_str()) == 0;
+    }
+
+    string ProgramCache::entryKey(const Context& context,
+                                  const string& sourceCode,
+                                  const string& options) const
+    {
+        // Source itself is not stored, only its hash and length
+        string key = "source " + 
+            detail::toHex(detail::hash64(sourceCode.data(), sourceCode.size())) + 
+            " " + std::to_string(static_cast<unsigned long long>(sourceCode.size())) + "\n";
+        key += "options " + options + "\n";
+        for(const Device& device : context.devices())
+            key += "device " + DeviceFingerprint(device).toString() + "\n";
+        return key;
+    }
+
+    string ProgramCache::entryFileName(const string& key) const
+    {
+        return _directory + detail::toHex(detail::hash64(key.data(), key.size())) + ".clbin";
+    }
+
+    Program ProgramCache::loadProgram(Context& context,
+                                      const string& key,
+                                      const string& options)
+    {
+        ByteCode contents;
+        if(!detail::readAsBytes(entryFileName(key), &contents))
+            return Program();
+
+        // Any mismatch is treated as a cache miss and entry gets overwritten
+        size_t pos = 0;
+        char magic[sizeof(detail::programCacheMagic)];
+        uint32_t version, keyLength, count;
+        if(!detail::extractValue(contents, pos, &magic) ||
+                memcmp(magic, detail::programCacheMagic, sizeof(magic)) != 0 ||
+                !detail::extractValue(contents, pos, &version) ||
+                version != detail::programCacheVersion ||
+                !detail::extractValue(contents, pos, &keyLength) ||
+                contents.size() - pos < keyLength ||
+                key.compare(0, string::npos, 
+                    reinterpret_cast<const char*>(contents.data() + pos), keyLength) != 0)
+            return Program();
+        pos += keyLength;
+
+        const vector<Device>& devs = context.devices();
+        if(!detail::extractValue(contents, pos, &count) || count != devs.size())
+            return Program();
+
+        vector<size_t> sizes(count);
+        for(size_t i = 0; i < count; ++i)
+        {
+            uint64_t size;
+            if(!detail::extractValue(contents, pos, &size))
+                return Program();
+            sizes[i] = size_t(size);
+        }
+
+        vector<cl_device_id> dids(count);
+        vector<const unsigned char*> ptrs(count);
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(contents.size() - pos < sizes[i])
+                return Program();
+            dids[i] = devs[i].deviceId();
+            ptrs[i] = contents.data() + pos;
+            pos += sizes[i];
+        }
+
+        cl_int error;
+        vector<cl_int> status(count);
+        cl_program pid = clCreateProgramWithBinary(context.contextId(), count,
+            dids.data(), sizes.data(), ptrs.data(), status.data(), &error);
+        if(error != CL_SUCCESS || !pid)
+            return Program();
+
+        Program program(&context, pid);
+        if(!program.build(options))
+            return Program();
+        return program;
+    }
+
+    bool ProgramCache::storeProgram(const Context& context,
+                                    const string& key,
+                                    const Program& program)
+    {
+        // Reorder binaries so they match context's device list
+        const vector<Device>& devs = context.devices();
+        vector<Device> programDevs = program.devices();
+        vector<ByteCode> bins = program.binaries();
+        if(bins.size() != programDevs.size() || devs.empty())
+            return false;
+
+        ByteCode contents;
+        detail::appendBytes(contents, detail::programCacheMagic, 
+            sizeof(detail::programCacheMagic));
+        detail::appendValue(contents, detail::programCacheVersion);
+        detail::appendValue(contents, uint32_t(key.size()));
+        detail::appendBytes(contents, key.data(), key.size());
+        detail::appendValue(contents, uint32_t(devs.size()));
+
+        vector<const ByteCode*> ordered;
+        for(const Device& device : devs)
+        {
+            const ByteCode* bin = nullptr;
+            for(size_t i = 0; i < programDevs.size(); ++i)
+            {
+                if(programDevs[i].deviceId() == device.deviceId())
+                    bin = &bins[i];
+            }
+            if(!bin || bin->empty())
+                return false;
+            detail::appendValue(contents, uint64_t(bin->size()));
+            ordered.push_back(bin);
+        }
+        for(const ByteCode* bin : ordered)
+            detail::appendBytes(contents, bin->data(), bin->size());
+
+        return detail::writeAtomically(entryFileName(key), 
+            contents.data(), contents.size());
+    }
+}
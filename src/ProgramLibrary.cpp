@@ -0,0 +1,183 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/ProgramLibrary.h"
+#include "clw/Context.h"
+#include "details.h"
+
+namespace clw
+{
+    ProgramLibrary::ProgramLibrary(Context* context)
+        : _ctx(context)
+    {
+    }
+
+    void ProgramLibrary::setContext(Context* context)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_ctx == context)
+            return;
+        _ctx = context;
+        _compiled.clear();
+        // Header programs belong to the old context
+        _headers.clear();
+        if(!_ctx)
+            return;
+        for(const string& source : _headerSources)
+            _headers.push_back(_ctx->createProgramFromSourceCode(source));
+    }
+
+    void ProgramLibrary::addHeader(const string& includeName, 
+                                   const string& sourceCode)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _headerNames.push_back(includeName);
+        _headerSources.push_back(sourceCode);
+        if(_ctx)
+            _headers.push_back(_ctx->createProgramFromSourceCode(sourceCode));
+        // Already compiled modules might have used previous version of a header
+        _compiled.clear();
+    }
+
+    bool ProgramLibrary::addHeaderFromFile(const string& includeName, 
+                                           const string& fileName)
+    {
+        string sourceCode;
+        if(!detail::readAsString(fileName, &sourceCode))
+            return false;
+        addHeader(includeName, sourceCode);
+        return true;
+    }
+
+    void ProgramLibrary::addModule(const string& name, const string& sourceCode)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _modules[name] = sourceCode;
+        auto it = _compiled.lower_bound(ModuleKey(name, string()));
+        while(it != _compiled.end() && it->first.first == name)
+            it = _compiled.erase(it);
+    }
+
+    bool ProgramLibrary::addModuleFromFile(const string& name, 
+                                           const string& fileName)
+    {
+        string sourceCode;
+        if(!detail::readAsString(fileName, &sourceCode))
+            return false;
+        addModule(name, sourceCode);
+        return true;
+    }
+
+    bool ProgramLibrary::hasModule(const string& name) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _modules.find(name) != _modules.end();
+    }
+
+    Program ProgramLibrary::compiledModule(const string& name, 
+                                           const string& options)
+    {
+        string sourceCode;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _compiled.find(ModuleKey(name, options));
+            if(it != _compiled.end())
+                return it->second;
+            auto mit = _modules.find(name);
+            if(mit == _modules.end())
+                return Program();
+            sourceCode = mit->second;
+        }
+
+        // Compile without holding the lock so other modules can be compiled
+        // concurrently. In the rare case of a race first result wins
+        Program object = compile(sourceCode, options);
+        if(object.isNull())
+            return Program();
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _compiled.insert(std::make_pair(
+            ModuleKey(name, options), object)).first->second;
+    }
+
+    Program ProgramLibrary::buildProgram(const string& sourceCode,
+                                         const vector<string>& modules,
+                                         const string& options,
+                                         const string& linkOptions)
+    {
+        if(!_ctx)
+            return Program();
+        vector<Program> objects;
+        objects.push_back(compile(sourceCode, options));
+        if(objects.back().isNull())
+            return Program();
+        for(const string& name : modules)
+        {
+            objects.push_back(compiledModule(name, options));
+            if(objects.back().isNull())
+                return Program();
+        }
+        return _ctx->linkPrograms(objects, linkOptions);
+    }
+
+    Program ProgramLibrary::buildProgramFromFile(const string& fileName,
+                                                 const vector<string>& modules,
+                                                 const string& options,
+                                                 const string& linkOptions)
+    {
+        string sourceCode;
+        if(!detail::readAsString(fileName, &sourceCode))
+            return Program();
+        return buildProgram(sourceCode, modules, options, linkOptions);
+    }
+
+    size_t ProgramLibrary::numCompiledModules() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _compiled.size();
+    }
+
+    void ProgramLibrary::clear()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _compiled.clear();
+    }
+
+    Program ProgramLibrary::compile(const string& sourceCode, 
+                                    const string& options)
+    {
+        vector<Program> headers;
+        vector<string> headerNames;
+        Context* ctx;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            headers = _headers;
+            headerNames = _headerNames;
+            ctx = _ctx;
+        }
+        if(!ctx)
+            return Program();
+        Program object = ctx->createProgramFromSourceCode(sourceCode);
+        if(object.isNull() || !object.compile(options, headers, headerNames))
+            return Program();
+        return object;
+    }
+}
@@ -0,0 +1,317 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/StagingRing.h"
+#include "clw/Context.h"
+#include "details.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace clw
+{
+    namespace detail
+    {
+        // Shared by all chunks of one asynchronous read
+        struct StagingReadState
+        {
+            StagingReadState(size_t numChunks, const UserEvent& done)
+                : remaining(numChunks), failed(false), done(done) {}
+
+            std::atomic<size_t> remaining;
+            std::atomic<bool> failed;
+            UserEvent done;
+        };
+
+        // Chunk read straight into destination has no source nor slot
+        struct StagingReadChunk
+        {
+            void* dst;
+            const void* src;
+            size_t size;
+            // Marks staging slot as reusable
+            UserEvent slotDone;
+            std::shared_ptr<StagingReadState> state;
+        };
+
+        void completeReadChunk(StagingReadChunk* chunk, cl_int status)
+        {
+            const bool success = status == CL_COMPLETE;
+            if(!success)
+                chunk->state->failed = true;
+            else if(chunk->src)
+                memcpy(chunk->dst, chunk->src, chunk->size);
+            if(!chunk->slotDone.isNull())
+                chunk->slotDone.setStatus(success ? EEventStatus::Complete : EEventStatus::Errored);
+            if(--chunk->state->remaining == 0)
+            {
+                chunk->state->done.setStatus(chunk->state->failed ? 
+                    EEventStatus::Errored : EEventStatus::Complete);
+            }
+            delete chunk;
+        }
+
+        void CL_CALLBACK stagingReadNotify(cl_event event, 
+                                           cl_int status, 
+                                           void* userData)
+        {
+            (void) event;
+            completeReadChunk(static_cast<StagingReadChunk*>(userData), status);
+        }
+    }
+
+    StagingRing::StagingRing()
+        : _slotSize(0)
+        , _nextSlot(0)
+    {
+    }
+
+    StagingRing::StagingRing(const CommandQueue& queue,
+                             size_t slotSize,
+                             size_t numSlots)
+        : _slotSize(0)
+        , _nextSlot(0)
+    {
+        create(queue, slotSize, numSlots);
+    }
+
+    StagingRing::~StagingRing()
+    {
+        release();
+    }
+
+    bool StagingRing::create(const CommandQueue& queue,
+                             size_t slotSize,
+                             size_t numSlots)
+    {
+        release();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        Context* ctx = queue.context();
+        if(!ctx || queue.isNull() || slotSize == 0 || numSlots == 0)
+            return false;
+
+        _queue = queue;
+        _slots.resize(numSlots);
+        for(Slot& slot : _slots)
+        {
+            slot.buffer = ctx->createBuffer(EAccess::ReadWrite, 
+                EMemoryLocation::AllocHostMemory, slotSize);
+            if(!slot.buffer.isNull())
+            {
+                slot.data = _queue.mapBuffer(slot.buffer, 
+                    EMapAccess::Read | EMapAccess::Write);
+            }
+            if(!slot.data)
+            {
+                _slots.clear();
+                return false;
+            }
+        }
+        _slotSize = slotSize;
+        _nextSlot = 0;
+        return true;
+    }
+
+    void StagingRing::release()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(Slot& slot : _slots)
+        {
+            slot.lastUse.waitForFinished();
+            if(slot.data)
+                _queue.unmap(slot.buffer, slot.data);
+        }
+        _slots.clear();
+        _slotSize = 0;
+    }
+
+    Event StagingRing::asyncWriteBuffer(Buffer& buffer,
+                                        const void* data,
+                                        size_t offset,
+                                        size_t size,
+                                        const EventList& after)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(isNull())
+            return _queue.asyncWriteBuffer(buffer, data, offset, size, after);
+
+        const unsigned char* src = static_cast<const unsigned char*>(data);
+        EventList chunks;
+        Event event;
+        for(size_t pos = 0; pos < size; pos += _slotSize)
+        {
+            const size_t chunkSize = std::min(_slotSize, size - pos);
+            Slot* slot = tryAcquireSlot();
+            if(slot)
+            {
+                memcpy(slot->data, src + pos, chunkSize);
+                event = _queue.asyncWriteBuffer(buffer, slot->data, 
+                    offset + pos, chunkSize, after);
+                if(event.isNull())
+                    return Event();
+                slot->lastUse = event;
+            }
+            else
+            {
+                // All slots busy - never wait for them (their commands may
+                // depend on events signaled by this very thread later on),
+                // write from a private copy freed once the command is done
+                std::shared_ptr<ByteCode> copy = std::make_shared<ByteCode>(
+                    src + pos, src + pos + chunkSize);
+                event = _queue.asyncWriteBuffer(buffer, copy->data(), 
+                    offset + pos, chunkSize, after);
+                if(event.isNull())
+                    return Event();
+                if(!event.setCallback(EEventStatus::Complete, 
+                        [copy](EEventStatus) {}))
+                    event.waitForFinished();
+            }
+            // Start DMA while next chunk is being copied
+            _queue.flush();
+            chunks.append(event);
+        }
+
+        // In-order queue completes chunks in order anyway
+        if(chunks.size() > 1 && _queue.isOutOfOrder())
+            return _queue.asyncMarker(chunks);
+        return event;
+    }
+
+    bool StagingRing::writeBuffer(Buffer& buffer,
+                                  const void* data,
+                                  size_t offset,
+                                  size_t size)
+    {
+        Event event = asyncWriteBuffer(buffer, data, offset, size);
+        if(event.isNull())
+            return size == 0;
+        event.waitForFinished();
+        return event.status() == EEventStatus::Complete;
+    }
+
+    Event StagingRing::asyncReadBuffer(const Buffer& buffer,
+                                       void* data,
+                                       size_t offset,
+                                       size_t size,
+                                       const EventList& after)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(isNull())
+            return _queue.asyncReadBuffer(buffer, data, offset, size, after);
+        if(size == 0)
+            return Event();
+
+        Context* ctx = _queue.context();
+        UserEvent done = ctx->createUserEvent();
+        // User events need +OpenCL 1.1
+        if(done.isNull())
+            return _queue.asyncReadBuffer(buffer, data, offset, size, after);
+
+        const size_t numChunks = (size + _slotSize - 1) / _slotSize;
+        auto state = std::make_shared<detail::StagingReadState>(numChunks, done);
+        unsigned char* dst = static_cast<unsigned char*>(data);
+
+        for(size_t i = 0; i < numChunks; ++i)
+        {
+            const size_t pos = i * _slotSize;
+            const size_t chunkSize = std::min(_slotSize, size - pos);
+            // All slots busy - read straight into destination rather than 
+            // wait for them
+            Slot* slot = tryAcquireSlot();
+
+            std::unique_ptr<detail::StagingReadChunk> chunk(new detail::StagingReadChunk);
+            chunk->dst = dst + pos;
+            chunk->src = slot ? slot->data : nullptr;
+            chunk->size = chunkSize;
+            chunk->state = state;
+            if(slot)
+                chunk->slotDone = ctx->createUserEvent();
+
+            Event event = slot && chunk->slotDone.isNull() ? Event() :
+                _queue.asyncReadBuffer(buffer, slot ? slot->data : chunk->dst, 
+                    offset + pos, chunkSize, after);
+            if(event.isNull())
+            {
+                // Fail remaining chunks so the returned event still completes
+                for(size_t j = i; j < numChunks; ++j)
+                {
+                    state->failed = true;
+                    if(--state->remaining == 0)
+                        done.setStatus(EEventStatus::Errored);
+                }
+                if(!chunk->slotDone.isNull())
+                    chunk->slotDone.setStatus(EEventStatus::Errored);
+                break;
+            }
+            _queue.flush();
+
+            if(slot)
+                slot->lastUse = chunk->slotDone;
+            cl_int error = clSetEventCallback(event.eventId(), CL_COMPLETE, 
+                &detail::stagingReadNotify, chunk.get());
+            if(error == CL_SUCCESS)
+            {
+                chunk.release();
+            }
+            else
+            {
+                detail::reportError("StagingRing::asyncReadBuffer(): ", error);
+                event.waitForFinished();
+                detail::completeReadChunk(chunk.release(), 
+                    event.status() == EEventStatus::Complete ? CL_COMPLETE : -1);
+            }
+        }
+        return done;
+    }
+
+    bool StagingRing::readBuffer(const Buffer& buffer,
+                                 void* data,
+                                 size_t offset,
+                                 size_t size)
+    {
+        Event event = asyncReadBuffer(buffer, data, offset, size);
+        if(event.isNull())
+            return size == 0;
+        event.waitForFinished();
+        return event.status() == EEventStatus::Complete;
+    }
+
+    StagingRing::Slot* StagingRing::tryAcquireSlot()
+    {
+        for(size_t i = 0; i < _slots.size(); ++i)
+        {
+            Slot& slot = _slots[_nextSlot];
+            _nextSlot = (_nextSlot + 1) % _slots.size();
+            // Complete or failed
+            if(slot.lastUse.isNull() || 
+                    cl_int(slot.lastUse.status()) <= cl_int(EEventStatus::Complete))
+            {
+                slot.lastUse = Event();
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+}
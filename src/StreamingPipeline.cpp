@@ -0,0 +1,208 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/StreamingPipeline.h"
+#include "clw/Context.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace clw
+{
+    StreamingPipeline::StreamingPipeline()
+        : _chunkElements(0)
+    {
+    }
+
+    StreamingPipeline::StreamingPipeline(Context* context, 
+                                         const Device& device,
+                                         size_t chunkElements,
+                                         size_t numSlots)
+        : _chunkElements(0)
+    {
+        create(context, device, chunkElements, numSlots);
+    }
+
+    StreamingPipeline::StreamingPipeline(const vector<CommandQueue>& queues,
+                                         size_t chunkElements,
+                                         size_t numSlots)
+        : _chunkElements(0)
+    {
+        create(queues, chunkElements, numSlots);
+    }
+
+    bool StreamingPipeline::create(Context* context, 
+                                   const Device& device,
+                                   size_t chunkElements,
+                                   size_t numSlots)
+    {
+        if(!context)
+            return false;
+        vector<CommandQueue> queues;
+        for(size_t i = 0; i < numSlots; ++i)
+        {
+            queues.push_back(context->createCommandQueue(device, CommandQueueFlags()));
+            if(queues.back().isNull())
+                return false;
+        }
+        return create(queues, chunkElements, numSlots);
+    }
+
+    bool StreamingPipeline::create(const vector<CommandQueue>& queues,
+                                   size_t chunkElements,
+                                   size_t numSlots)
+    {
+        _queues.clear();
+        _slots.clear();
+        _chunkElements = 0;
+        if(queues.empty() || chunkElements == 0 || numSlots == 0)
+            return false;
+        for(const CommandQueue& queue : queues)
+        {
+            if(queue.isNull() || !queue.context())
+                return false;
+        }
+
+        _queues = queues;
+        _slots.resize(numSlots);
+        for(size_t i = 0; i < numSlots; ++i)
+            _slots[i].queueIndex = i % _queues.size();
+        _chunkElements = chunkElements;
+        return true;
+    }
+
+    bool StreamingPipeline::run(const void* input, 
+                                size_t inputElementSize,
+                                void* output,
+                                size_t outputElementSize,
+                                size_t numElements,
+                                const StreamingKernelStage& stage)
+    {
+        if(isNull() || !stage || !input || inputElementSize == 0)
+            return false;
+        if(!output)
+            outputElementSize = 0;
+
+        const size_t chunkElements = std::min(_chunkElements, numElements);
+        if(!reserveBuffers(chunkElements * inputElementSize,
+                           chunkElements * outputElementSize))
+            return false;
+
+        using namespace std::chrono;
+        const auto start = steady_clock::now();
+        const unsigned char* src = static_cast<const unsigned char*>(input);
+        unsigned char* dst = static_cast<unsigned char*>(output);
+        bool success = true;
+
+        size_t index = 0;
+        for(size_t offset = 0; offset < numElements; offset += chunkElements, ++index)
+        {
+            Slot& slot = _slots[index % _slots.size()];
+            CommandQueue& queue = _queues[slot.queueIndex];
+
+            if(!slot.done.isNull())
+            {
+                if(slot.done.status() != EEventStatus::Complete)
+                {
+                    ++_stats.hostStalls;
+                    slot.done.waitForFinished();
+                }
+                if(slot.done.status() != EEventStatus::Complete)
+                    success = false;
+                slot.done = Event();
+            }
+            if(!success)
+                break;
+
+            StreamingChunk chunk;
+            chunk.index = index;
+            chunk.offset = offset;
+            chunk.count = std::min(chunkElements, numElements - offset);
+            chunk.input = &slot.input;
+            chunk.output = &slot.output;
+
+            const size_t inputBytes = chunk.count * inputElementSize;
+            Event event = queue.asyncWriteBuffer(slot.input, 
+                src + offset * inputElementSize, 0, inputBytes);
+            if(!event.isNull())
+                event = stage(queue, chunk, EventList(event));
+            if(!event.isNull() && outputElementSize > 0)
+            {
+                event = queue.asyncReadBuffer(slot.output, 
+                    dst + offset * outputElementSize, 0, 
+                    chunk.count * outputElementSize, EventList(event));
+            }
+            if(event.isNull())
+            {
+                success = false;
+                break;
+            }
+            queue.flush();
+            slot.done = event;
+
+            ++_stats.chunks;
+            _stats.elements += chunk.count;
+            _stats.bytesUploaded += inputBytes;
+            _stats.bytesDownloaded += chunk.count * outputElementSize;
+        }
+
+        for(Slot& slot : _slots)
+        {
+            if(slot.done.isNull())
+                continue;
+            slot.done.waitForFinished();
+            if(slot.done.status() != EEventStatus::Complete)
+                success = false;
+            slot.done = Event();
+        }
+        // Stage might have enqueued work not tracked by returned event
+        for(CommandQueue& queue : _queues)
+            queue.finish();
+
+        _stats.elapsedNs += uint64_t(duration_cast<nanoseconds>(
+            steady_clock::now() - start).count());
+        return success;
+    }
+
+    bool StreamingPipeline::reserveBuffers(size_t inputBytes, size_t outputBytes)
+    {
+        for(Slot& slot : _slots)
+        {
+            Context* ctx = _queues[slot.queueIndex].context();
+            if(inputBytes > 0 && (slot.input.isNull() || slot.input.size() < inputBytes))
+            {
+                slot.input = ctx->createBuffer(EAccess::ReadOnly, 
+                    EMemoryLocation::Device, inputBytes);
+                if(slot.input.isNull())
+                    return false;
+            }
+            if(outputBytes > 0 && (slot.output.isNull() || slot.output.size() < outputBytes))
+            {
+                slot.output = ctx->createBuffer(EAccess::WriteOnly, 
+                    EMemoryLocation::Device, outputBytes);
+                if(slot.output.isNull())
+                    return false;
+            }
+        }
+        return true;
+    }
+}
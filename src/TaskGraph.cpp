@@ -0,0 +1,401 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/TaskGraph.h"
+#include "clw/Buffer.h"
+#include "clw/MemoryObject.h"
+#include "details.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace clw
+{
+    namespace detail
+    {
+        vector<cl_mem> memoryIds(const vector<const MemoryObject*>& objects)
+        {
+            vector<cl_mem> ids;
+            for(const MemoryObject* obj : objects)
+            {
+                if(obj && !obj->isNull())
+                    ids.push_back(obj->memoryId());
+            }
+            return ids;
+        }
+
+        // Dynamically sized bit set of node ancestors
+        class NodeSet
+        {
+        public:
+            explicit NodeSet(size_t size) : _words((size + 63) / 64, 0) {}
+
+            void insert(size_t index) { _words[index / 64] |= uint64_t(1) << (index % 64); }
+            bool contains(size_t index) const 
+            { 
+                return (_words[index / 64] & (uint64_t(1) << (index % 64))) != 0; 
+            }
+            void unite(const NodeSet& other)
+            {
+                for(size_t i = 0; i < _words.size(); ++i)
+                    _words[i] |= other._words[i];
+            }
+
+        private:
+            vector<uint64_t> _words;
+        };
+    }
+
+    TaskGraph::TaskGraph(const vector<CommandQueue>& queues)
+        : _queues(queues)
+        , _compiled(false)
+    {
+    }
+
+    void TaskGraph::setCommandQueues(const vector<CommandQueue>& queues)
+    {
+        _queues = queues;
+        // Queue indices of previous execution no longer mean the same queues
+        _eventQueues.assign(_eventQueues.size(), -1);
+        _compiled = false;
+    }
+
+    TaskGraph::NodeId TaskGraph::addTask(const TaskFunction& task,
+                                         const vector<const MemoryObject*>& reads,
+                                         const vector<const MemoryObject*>& writes,
+                                         int queueIndex)
+    {
+        Node node;
+        node.task = task;
+        node.reads = detail::memoryIds(reads);
+        node.writes = detail::memoryIds(writes);
+        node.requestedQueue = queueIndex;
+        node.queue = -1;
+        node.isRoot = true;
+        node.isSink = true;
+        _nodes.push_back(std::move(node));
+        _compiled = false;
+        return _nodes.size() - 1;
+    }
+
+    TaskGraph::NodeId TaskGraph::addKernel(const Kernel& kernel,
+                                           const vector<const MemoryObject*>& reads,
+                                           const vector<const MemoryObject*>& writes,
+                                           const function<void(Kernel&)>& bindArgs,
+                                           int queueIndex)
+    {
+        Kernel k = kernel;
+        return addTask([k, bindArgs](CommandQueue& queue, const EventList& after) mutable
+        {
+            if(bindArgs)
+                bindArgs(k);
+            return queue.asyncRunKernel(k, after);
+        }, reads, writes, queueIndex);
+    }
+
+    TaskGraph::NodeId TaskGraph::addWriteBuffer(Buffer& buffer, const void* data,
+                                                size_t offset, size_t size, 
+                                                int queueIndex)
+    {
+        Buffer b = buffer;
+        return addTask([b, data, offset, size](CommandQueue& queue, 
+                                               const EventList& after) mutable
+        {
+            return queue.asyncWriteBuffer(b, data, offset, size, after);
+        }, vector<const MemoryObject*>(), vector<const MemoryObject*>(1, &buffer),
+        queueIndex);
+    }
+
+    TaskGraph::NodeId TaskGraph::addReadBuffer(const Buffer& buffer, void* data,
+                                               size_t offset, size_t size, 
+                                               int queueIndex)
+    {
+        Buffer b = buffer;
+        return addTask([b, data, offset, size](CommandQueue& queue, 
+                                               const EventList& after)
+        {
+            return queue.asyncReadBuffer(b, data, offset, size, after);
+        }, vector<const MemoryObject*>(1, &buffer), vector<const MemoryObject*>(),
+        queueIndex);
+    }
+
+    TaskGraph::NodeId TaskGraph::addCopyBuffer(const Buffer& src, const Buffer& dst,
+                                               int queueIndex)
+    {
+        Buffer s = src, d = dst;
+        return addTask([s, d](CommandQueue& queue, const EventList& after)
+        {
+            return queue.asyncCopyBuffer(s, d, after);
+        }, vector<const MemoryObject*>(1, &src), vector<const MemoryObject*>(1, &dst),
+        queueIndex);
+    }
+
+    void TaskGraph::addDependency(NodeId before, NodeId after)
+    {
+        // Nodes are submitted in insertion order so only forward edges make sense
+        if(before >= after || after >= _nodes.size())
+            return;
+        _nodes[after].extraDeps.push_back(before);
+        _compiled = false;
+    }
+
+    void TaskGraph::clear()
+    {
+        _nodes.clear();
+        _events.clear();
+        _eventQueues.clear();
+        _compiled = false;
+    }
+
+    bool TaskGraph::compile()
+    {
+        _compiled = false;
+        if(_queues.empty())
+            return false;
+
+        const size_t numNodes = _nodes.size();
+        vector<bool> outOfOrder(_queues.size());
+        for(size_t q = 0; q < _queues.size(); ++q)
+            outOfOrder[q] = _queues[q].isOutOfOrder();
+
+        // Memory accesses in insertion order grouped by root allocation, so
+        // overlapping sub-buffers (and sub-buffers of their parent) conflict.
+        // Redundant edges are dropped by transitive reduction below
+        struct Access
+        {
+            detail::MemoryRange range;
+            NodeId node;
+            bool write;
+        };
+        std::unordered_map<cl_mem, detail::MemoryRange> ranges;
+        std::unordered_map<cl_mem, vector<Access>> accesses;
+        auto rangeOf = [&ranges](cl_mem mem) -> const detail::MemoryRange&
+        {
+            auto it = ranges.find(mem);
+            if(it == ranges.end())
+                it = ranges.insert(std::make_pair(mem, detail::memoryRange(mem))).first;
+            return it->second;
+        };
+        vector<vector<NodeId>> deps(numNodes);
+
+        for(NodeId i = 0; i < numNodes; ++i)
+        {
+            const Node& node = _nodes[i];
+            vector<NodeId>& d = deps[i];
+            d = node.extraDeps;
+            // Reads wait for earlier writes, writes for any earlier access
+            for(int write = 0; write < 2; ++write)
+            {
+                for(cl_mem mem : write ? node.writes : node.reads)
+                {
+                    const detail::MemoryRange& range = rangeOf(mem);
+                    for(const Access& access : accesses[range.root])
+                    {
+                        if((write || access.write) && access.range.overlaps(range))
+                            d.push_back(access.node);
+                    }
+                }
+            }
+            for(int write = 0; write < 2; ++write)
+            {
+                for(cl_mem mem : write ? node.writes : node.reads)
+                {
+                    const detail::MemoryRange& range = rangeOf(mem);
+                    Access access = { range, i, write != 0 };
+                    accesses[range.root].push_back(access);
+                }
+            }
+            std::sort(d.begin(), d.end());
+            d.erase(std::unique(d.begin(), d.end()), d.end());
+            d.erase(std::remove(d.begin(), d.end(), i), d.end());
+        }
+
+        // Transitive reduction - drop dependency on p if it is already 
+        // an ancestor of another dependency
+        vector<detail::NodeSet> ancestors(numNodes, detail::NodeSet(numNodes));
+        vector<bool> continued(numNodes, false);
+        size_t nextQueue = 0;
+
+        for(NodeId i = 0; i < numNodes; ++i)
+        {
+            Node& node = _nodes[i];
+            vector<NodeId> reduced;
+            for(NodeId p : deps[i])
+            {
+                bool implied = false;
+                for(NodeId q : deps[i])
+                {
+                    if(q != p && ancestors[q].contains(p))
+                    {
+                        implied = true;
+                        break;
+                    }
+                }
+                if(!implied)
+                    reduced.push_back(p);
+                ancestors[i].unite(ancestors[p]);
+                ancestors[i].insert(p);
+            }
+
+            // Continue a chain on its predecessor's queue, branches go 
+            // to other queues round-robin
+            node.queue = -1;
+            if(node.requestedQueue >= 0 && size_t(node.requestedQueue) < _queues.size())
+                node.queue = node.requestedQueue;
+            for(NodeId p : reduced)
+            {
+                if(continued[p])
+                    continue;
+                if(node.queue < 0 || node.queue == _nodes[p].queue)
+                {
+                    node.queue = _nodes[p].queue;
+                    continued[p] = true;
+                    break;
+                }
+            }
+            if(node.queue < 0)
+                node.queue = int(nextQueue++ % _queues.size());
+
+            // In-order queue already serializes commands submitted to it
+            node.waitFor.clear();
+            node.isRoot = reduced.empty();
+            node.isSink = true;
+            for(NodeId p : reduced)
+            {
+                _nodes[p].isSink = false;
+                if(_nodes[p].queue != node.queue || outOfOrder[node.queue])
+                    node.waitFor.push_back(p);
+            }
+        }
+
+        // Previous execution conflicts with any access of the graph. Drop 
+        // nodes already waited for through ancestors within the graph or 
+        // implied by another previous node waited for
+        vector<detail::NodeSet> previousCovered(numNodes, detail::NodeSet(numNodes));
+        for(NodeId i = 0; i < numNodes; ++i)
+        {
+            Node& node = _nodes[i];
+            vector<NodeId> previous;
+            for(int write = 0; write < 2; ++write)
+            {
+                for(cl_mem mem : write ? node.writes : node.reads)
+                {
+                    const detail::MemoryRange& range = rangeOf(mem);
+                    for(const Access& access : accesses[range.root])
+                    {
+                        if((write || access.write) && access.range.overlaps(range))
+                            previous.push_back(access.node);
+                    }
+                }
+            }
+            std::sort(previous.begin(), previous.end());
+            previous.erase(std::unique(previous.begin(), previous.end()), previous.end());
+
+            for(NodeId p : deps[i])
+                previousCovered[i].unite(previousCovered[p]);
+            node.waitForPrevious.clear();
+            for(NodeId p : previous)
+            {
+                bool implied = previousCovered[i].contains(p);
+                for(NodeId q : previous)
+                {
+                    if(implied)
+                        break;
+                    implied = q != p && ancestors[q].contains(p);
+                }
+                if(!implied)
+                    node.waitForPrevious.push_back(p);
+            }
+            for(NodeId p : node.waitForPrevious)
+            {
+                previousCovered[i].unite(ancestors[p]);
+                previousCovered[i].insert(p);
+            }
+        }
+
+        _compiled = true;
+        return true;
+    }
+
+    size_t TaskGraph::numEdges() const
+    {
+        size_t edges = 0;
+        for(const Node& node : _nodes)
+            edges += node.waitFor.size();
+        return edges;
+    }
+
+    int TaskGraph::nodeQueue(NodeId node) const
+    {
+        return node < _nodes.size() ? _nodes[node].queue : -1;
+    }
+
+    EventList TaskGraph::execute(const EventList& after)
+    {
+        if(!_compiled && !compile())
+            return EventList();
+
+        vector<bool> outOfOrder(_queues.size());
+        for(size_t q = 0; q < _queues.size(); ++q)
+            outOfOrder[q] = _queues[q].isOutOfOrder();
+
+        // Nodes added since previous execution have no previous events
+        vector<Event> previous(std::move(_events));
+        vector<int> previousQueues(std::move(_eventQueues));
+        _events.assign(_nodes.size(), Event());
+        _eventQueues.assign(_nodes.size(), -1);
+
+        for(size_t i = 0; i < _nodes.size(); ++i)
+        {
+            const Node& node = _nodes[i];
+            EventList wait;
+            if(node.isRoot)
+                wait = after;
+            for(NodeId p : node.waitForPrevious)
+            {
+                // Already serialized by the same in-order queue
+                if(p >= previous.size() || previous[p].isNull() ||
+                   (previousQueues[p] == node.queue && !outOfOrder[node.queue]))
+                    continue;
+                wait.append(previous[p]);
+            }
+            for(NodeId p : node.waitFor)
+            {
+                // Task that failed to enqueue has nothing to wait for
+                if(!_events[p].isNull())
+                    wait.append(_events[p]);
+            }
+            _events[i] = node.task(_queues[node.queue], wait);
+            _eventQueues[i] = node.queue;
+        }
+        for(CommandQueue& queue : _queues)
+            queue.flush();
+
+        EventList sinks;
+        for(size_t i = 0; i < _nodes.size(); ++i)
+        {
+            if(_nodes[i].isSink && !_events[i].isNull())
+                sinks.append(_events[i]);
+        }
+        return sinks;
+    }
+}
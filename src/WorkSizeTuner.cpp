@@ -0,0 +1,388 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+    
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+#include "clw/WorkSizeTuner.h"
+#include "clw/Context.h"
+#include "clw/CommandQueue.h"
+#include "clw/Kernel.h"
+#include "clw/Device.h"
+#include "clw/ProgramBundle.h"
+#include "details.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <sstream>
+
+namespace clw
+{
+    namespace detail
+    {
+        size_t nextPowerOfTwo(size_t value)
+        {
+            size_t pow = 1;
+            while(pow < value)
+                pow <<= 1;
+            return pow;
+        }
+
+        string gridToString(const Grid& grid)
+        {
+            std::ostringstream strm;
+            strm << grid.dimensions() << ' ' << grid.width() << ' ' 
+                 << grid.height() << ' ' << grid.depth();
+            return strm.str();
+        }
+
+        bool gridFromString(const string& str, Grid* grid)
+        {
+            std::istringstream strm(str);
+            cl_uint dims;
+            size_t w, h, d;
+            if(!(strm >> dims >> w >> h >> d))
+                return false;
+            switch(dims)
+            {
+            case 1: *grid = Grid(w); return true;
+            case 2: *grid = Grid(w, h); return true;
+            case 3: *grid = Grid(w, h, d); return true;
+            default: return false;
+            }
+        }
+
+        Grid makeGrid(cl_uint dims, const size_t* sizes)
+        {
+            switch(dims)
+            {
+            case 2: return Grid(sizes[0], sizes[1]);
+            case 3: return Grid(sizes[0], sizes[1], sizes[2]);
+            default: return Grid(sizes[0]);
+            }
+        }
+    }
+
+    WorkSizeTuner::WorkSizeTuner()
+        : _iterations(5)
+    {
+    }
+
+    WorkSizeTuner::WorkSizeTuner(const string& databaseFile)
+        : _databaseFile(databaseFile)
+        , _iterations(5)
+    {
+        load(databaseFile);
+    }
+
+    WorkSizeTuner::~WorkSizeTuner()
+    {
+        releaseIdentities();
+    }
+
+    bool WorkSizeTuner::load(const string& fileName)
+    {
+        string contents;
+        if(!detail::readAsString(fileName, &contents))
+            return false;
+
+        std::map<string, Entry> entries;
+        std::istringstream strm(contents);
+        string line;
+        while(std::getline(strm, line))
+        {
+            // key <tab> dims width height depth <tab> time
+            const size_t tab1 = line.find('\t');
+            const size_t tab2 = line.find('\t', tab1 + 1);
+            if(tab1 == string::npos || tab2 == string::npos)
+                continue;
+            Entry entry;
+            std::istringstream timeStrm(line.substr(tab2 + 1));
+            if(!detail::gridFromString(line.substr(tab1 + 1, tab2 - tab1 - 1), 
+                    &entry.localSize) || !(timeStrm >> entry.timeNs))
+                continue;
+            entries[line.substr(0, tab1)] = entry;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(const auto& entry : entries)
+            _entries[entry.first] = entry.second;
+        return true;
+    }
+
+    bool WorkSizeTuner::save() const
+    {
+        return !_databaseFile.empty() && save(_databaseFile);
+    }
+
+    bool WorkSizeTuner::save(const string& fileName) const
+    {
+        std::ostringstream strm;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for(const auto& entry : _entries)
+            {
+                strm << entry.first << '\t' 
+                     << detail::gridToString(entry.second.localSize) << '\t'
+                     << entry.second.timeNs << '\n';
+            }
+        }
+        const string contents = strm.str();
+        return detail::writeAtomically(fileName, contents.data(), contents.size());
+    }
+
+    void WorkSizeTuner::setIterations(int iterations)
+    {
+        _iterations = std::max(1, iterations);
+    }
+
+    Grid WorkSizeTuner::tune(Kernel& kernel, CommandQueue& queue,
+                             const Grid& globalSize)
+    {
+        const Device device = queue.device();
+        const string key = entryKey(kernel, device, globalSize);
+        Grid localSize;
+        if(lookup(key, &localSize))
+        {
+            kernel.setLocalWorkSize(localSize);
+            kernel.setRoundedGlobalWorkSize(globalSize);
+            return localSize;
+        }
+
+        CommandQueue profilingQueue = queue;
+        if(!queue.isProfilingEnabled() && queue.context())
+        {
+            profilingQueue = queue.context()->createCommandQueue(device, 
+                ECommandQueueProperty::ProfilingEnabled);
+        }
+        if(profilingQueue.isNull() || !profilingQueue.isProfilingEnabled())
+            return kernel.localWorkSize();
+
+        Entry best;
+        best.timeNs = std::numeric_limits<uint64_t>::max();
+        for(const Grid& candidate : candidates(kernel, device, globalSize))
+        {
+            kernel.setLocalWorkSize(candidate);
+            kernel.setRoundedGlobalWorkSize(globalSize);
+
+            // First run is a warm-up (lazy allocations, code upload)
+            Event event = profilingQueue.asyncRunKernel(kernel);
+            if(event.isNull())
+                continue;
+            event.waitForFinished();
+            if(event.status() != EEventStatus::Complete)
+                continue;
+
+            uint64_t timeNs = std::numeric_limits<uint64_t>::max();
+            for(int i = 0; i < _iterations; ++i)
+            {
+                event = profilingQueue.asyncRunKernel(kernel);
+                if(event.isNull())
+                    break;
+                event.waitForFinished();
+                // Failed run has no meaningful timestamps
+                if(cl_int(event.status()) < 0)
+                    continue;
+                timeNs = std::min(timeNs, event.finishTime() - event.startTime());
+            }
+
+            if(timeNs < best.timeNs)
+            {
+                best.localSize = candidate;
+                best.timeNs = timeNs;
+            }
+        }
+
+        if(best.timeNs == std::numeric_limits<uint64_t>::max())
+            best.localSize = Grid(0);
+        else
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries[key] = best;
+        }
+
+        kernel.setLocalWorkSize(best.localSize);
+        kernel.setRoundedGlobalWorkSize(globalSize);
+        return best.localSize;
+    }
+
+    bool WorkSizeTuner::lookup(const Kernel& kernel, const Device& device, 
+                               const Grid& globalSize, Grid* localSize) const
+    {
+        return lookup(entryKey(kernel, device, globalSize), localSize);
+    }
+
+    bool WorkSizeTuner::lookup(const string& key, Grid* localSize) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if(it == _entries.end())
+            return false;
+        if(localSize)
+            *localSize = it->second.localSize;
+        return true;
+    }
+
+    size_t WorkSizeTuner::size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _entries.size();
+    }
+
+    void WorkSizeTuner::clear()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _entries.clear();
+        }
+        releaseIdentities();
+    }
+
+    vector<Grid> WorkSizeTuner::candidates(const Kernel& kernel, 
+                                           const Device& device,
+                                           const Grid& globalSize)
+    {
+        vector<Grid> grids(1, Grid(0));
+
+        // reqd_work_group_size leaves no choice
+        const Grid required = kernel.requiredWorkGroupSize(device);
+        if(required.width() != 0)
+        {
+            grids.push_back(required);
+            return grids;
+        }
+
+        const size_t maxGroup = std::min(
+            size_t(std::max(kernel.maximumWorkItemsPerGroup(device), 1)), 
+            std::max<size_t>(device.maximumWorkItemsPerGroup(), 1));
+        const size_t multiple = std::min(maxGroup, 
+            size_t(std::max(kernel.preferredMultipleWorkGroupSize(device), 1)));
+        const Grid maxItems = device.maximumWorkItemSize();
+        const cl_uint dims = std::min<cl_uint>(std::max<cl_uint>(
+            globalSize.dimensions(), 1), 3);
+
+        // Powers of two in every dimension plus multiples of preferred 
+        // size in the first one, not (much) larger than the global size
+        std::set<size_t> values[3];
+        for(cl_uint d = 0; d < dims; ++d)
+        {
+            const size_t limit = std::min(std::max<size_t>(maxItems[d], 1),
+                detail::nextPowerOfTwo(std::max<size_t>(globalSize[d], 1)));
+            for(size_t v = 1; v <= limit; v <<= 1)
+                values[d].insert(v);
+            if(d == 0)
+            {
+                for(size_t v = multiple; v <= std::min<size_t>(maxItems[0], 
+                        std::max(limit, multiple)); v <<= 1)
+                    values[d].insert(v);
+            }
+            // Keep the number of 3D configurations reasonable
+            if(d == 2)
+            {
+                while(values[d].size() > 1 && *values[d].rbegin() > 16)
+                    values[d].erase(std::prev(values[d].end()));
+            }
+        }
+        for(cl_uint d = dims; d < 3; ++d)
+            values[d].insert(1);
+
+        for(size_t x : values[0])
+        {
+            for(size_t y : values[1])
+            {
+                for(size_t z : values[2])
+                {
+                    const size_t items = x * y * z;
+                    if(items > maxGroup || items < multiple)
+                        continue;
+                    const size_t sizes[3] = { x, y, z };
+                    grids.push_back(detail::makeGrid(dims, sizes));
+                }
+            }
+        }
+        return grids;
+    }
+
+    string WorkSizeTuner::entryKey(const Kernel& kernel, const Device& device,
+                                   const Grid& globalSize) const
+    {
+        return kernel.name() + "|" + programIdentity(kernel, device) +
+            "|" + DeviceFingerprint(device).toString() + 
+            "|" + detail::gridToString(globalSize);
+    }
+
+    // Same-named kernels from programs built with different options 
+    // (e.g. -D variants) or sources must not share tuned sizes. Only the 
+    // hash goes into the key - options may contain tabs or newlines
+    string WorkSizeTuner::programIdentity(const Kernel& kernel, 
+                                          const Device& device) const
+    {
+        Program program = kernel.program();
+        if(program.isNull())
+            return string();
+        const std::pair<cl_program, cl_device_id> id(program.programId(), 
+                                                     device.deviceId());
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto it = _identities.find(id);
+            if(it != _identities.end())
+                return it->second;
+        }
+
+        string options;
+        size_t size = 0;
+        if(clGetProgramBuildInfo(id.first, id.second, CL_PROGRAM_BUILD_OPTIONS, 
+                0, nullptr, &size) == CL_SUCCESS && size > 1)
+        {
+            options.resize(size);
+            clGetProgramBuildInfo(id.first, id.second, CL_PROGRAM_BUILD_OPTIONS, 
+                size, &options[0], nullptr);
+            options.resize(size - 1);
+        }
+
+        uint64_t hash = detail::hash64(options.data(), options.size());
+        const string source = program.sourceCode();
+        if(!source.empty())
+        {
+            hash = detail::hash64(source.data(), source.size(), hash);
+        }
+        else
+        {
+            // Created from binaries
+            for(const ByteCode& binary : program.binaries())
+                hash = detail::hash64(binary.data(), binary.size(), hash);
+        }
+        const string identity = detail::toHex(hash);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_identities.insert(std::make_pair(id, identity)).second)
+            clRetainProgram(id.first);
+        return identity;
+    }
+
+    void WorkSizeTuner::releaseIdentities()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(const auto& identity : _identities)
+            clReleaseProgram(identity.first.first);
+        _identities.clear();
+    }
+}
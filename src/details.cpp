@@ -21,10 +21,28 @@
 */
 
 #include "clw/Prerequisites.h"
+#include "details.h"
 
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+#  if !defined(NOMINMAX)
+#    define NOMINMAX
+#  endif
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <direct.h>
+#else
+#  include <sys/stat.h>
+#  include <sys/types.h>
+#endif
 
 namespace clw
 {
@@ -131,5 +149,123 @@ namespace clw
                 std::istreambuf_iterator<char>());
             return true;
         }
+
+        bool readAsBytes(const string& filename, vector<unsigned char>* contents)
+        {
+            std::ifstream strm;
+            strm.open(filename.c_str(), std::ios::binary | std::ios_base::in);
+            if(!strm.is_open())
+                return false;
+            strm.seekg(0, std::ios::end);
+            std::streamoff length = strm.tellg();
+            if(length < 0)
+                return false;
+            strm.seekg(0);
+            contents->resize(static_cast<size_t>(length));
+            if(length > 0)
+                strm.read(reinterpret_cast<char*>(contents->data()), length);
+            return !strm.fail();
+        }
+
+        bool writeAtomically(const string& filename, const void* data, size_t size)
+        {
+            // Unique name so that concurrent writers (threads or processes)
+            // never share the temporary file
+            static std::atomic<unsigned> counter(0);
+            uint64_t salt = uint64_t(std::chrono::high_resolution_clock::now()
+                .time_since_epoch().count());
+            salt ^= uint64_t(std::hash<std::thread::id>()(std::this_thread::get_id())) << 1;
+            salt ^= uint64_t(counter++) << 48;
+            const string tmpName = filename + "." + toHex(hash64(&salt, sizeof(salt))) + ".tmp";
+
+            {
+                std::ofstream strm;
+                strm.open(tmpName.c_str(), std::ios::binary | std::ios_base::out | std::ios_base::trunc);
+                if(!strm.is_open())
+                    return false;
+                strm.write(static_cast<const char*>(data), std::streamsize(size));
+                strm.close();
+                if(strm.fail())
+                {
+                    std::remove(tmpName.c_str());
+                    return false;
+                }
+            }
+
+#if defined(_WIN32)
+            // rename() refuses to replace existing file on Windows
+            if(!MoveFileExA(tmpName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+            if(std::rename(tmpName.c_str(), filename.c_str()) != 0)
+#endif
+            {
+                std::remove(tmpName.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        bool makeDirectory(const string& path)
+        {
+#if defined(_WIN32)
+            return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+            return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+        }
+
+        // 64-bit FNV-1a
+        uint64_t hash64(const void* data, size_t size, uint64_t seed)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            uint64_t hash = seed;
+            for(size_t i = 0; i < size; ++i)
+            {
+                hash ^= uint64_t(bytes[i]);
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        MemoryRange memoryRange(cl_mem mem)
+        {
+            MemoryRange range;
+            range.root = mem;
+            range.offset = 0;
+            range.size = size_t(-1);
+            if(!mem)
+                return range;
+
+            size_t size;
+            if(clGetMemObjectInfo(mem, CL_MEM_SIZE, sizeof(size_t), 
+                    &size, nullptr) == CL_SUCCESS)
+                range.size = size;
+#if defined(HAVE_OPENCL_1_1)
+            // Sub-buffers can't be nested so one level is enough
+            cl_mem parent = nullptr;
+            size_t offset = 0;
+            if(clGetMemObjectInfo(mem, CL_MEM_ASSOCIATED_MEMOBJECT, 
+                    sizeof(cl_mem), &parent, nullptr) == CL_SUCCESS && parent &&
+                    clGetMemObjectInfo(mem, CL_MEM_OFFSET, 
+                    sizeof(size_t), &offset, nullptr) == CL_SUCCESS)
+            {
+                range.root = parent;
+                range.offset = offset;
+            }
+#endif
+            return range;
+        }
+
+        string toHex(uint64_t value)
+        {
+            static const char digits[] = "0123456789abcdef";
+            string hex(16, '0');
+            for(int i = 15; i >= 0; --i)
+            {
+                hex[i] = digits[value & 0xF];
+                value >>= 4;
+            }
+            return hex;
+        }
     }
 }
\ No newline at end of file
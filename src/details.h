@@ -24,14 +24,81 @@
 
 #include "clw/Prerequisites.h"
 
+#include <cstring>
+
 namespace clw
 {
     namespace detail
     {
+        // Also stores the error as calling thread's last error
         void reportError(const char* name, cl_int eid);
+        cl_int& threadLastError();
         bool supportsExtension(const string& list, const char* ext);
         vector<string> tokenize(const string& str, char delim, char group = 0);
         void trim(string* str, bool left, bool right);
         bool readAsString(const string& filename, string* contents);
+        bool readAsBytes(const string& filename, vector<unsigned char>* contents);
+        // Writes to a temporary file first and renames it over the target
+        bool writeAtomically(const string& filename, const void* data, size_t size);
+        bool makeDirectory(const string& path);
+        uint64_t hash64(const void* data, size_t size, 
+                        uint64_t seed = 14695981039346656037ULL);
+        string toHex(uint64_t value);
+
+        // Bytes of a memory object within its root allocation - sub-buffers
+        // resolve to their parent so aliasing ones can be told apart
+        struct MemoryRange
+        {
+            cl_mem root;
+            size_t offset;
+            size_t size;
+
+            bool overlaps(const MemoryRange& other) const
+            {
+                return root == other.root && 
+                    offset < other.offset + other.size &&
+                    other.offset < offset + size;
+            }
+        };
+        MemoryRange memoryRange(cl_mem mem);
+
+        // Helpers for (de)serializing simple binary formats
+        inline void appendBytes(vector<unsigned char>& out, const void* data, size_t size)
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            out.insert(out.end(), bytes, bytes + size);
+        }
+
+        template<typename Value>
+        void appendValue(vector<unsigned char>& out, const Value& value)
+        {
+            appendBytes(out, &value, sizeof(Value));
+        }
+
+        inline void appendString(vector<unsigned char>& out, const string& str)
+        {
+            appendValue(out, uint32_t(str.size()));
+            appendBytes(out, str.data(), str.size());
+        }
+
+        template<typename Value>
+        bool extractValue(const vector<unsigned char>& in, size_t& pos, Value* value)
+        {
+            if(in.size() - pos < sizeof(Value))
+                return false;
+            std::memcpy(value, in.data() + pos, sizeof(Value));
+            pos += sizeof(Value);
+            return true;
+        }
+
+        inline bool extractString(const vector<unsigned char>& in, size_t& pos, string* str)
+        {
+            uint32_t length;
+            if(!extractValue(in, pos, &length) || in.size() - pos < length)
+                return false;
+            str->assign(reinterpret_cast<const char*>(in.data() + pos), length);
+            pos += length;
+            return true;
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,254 @@
+/*
+    Copyright (c) 2012, 2013 Kajetan Swierk <k0zmo@outlook.com>
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to deal
+    in the Software without restriction, including without limitation the rights
+    to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+    copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+    THE SOFTWARE.
+*/
+
+
+#include <clw/clw.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Offline OpenCL C compiler - builds given source files for every available 
+// (or, with --offline, every device known to the driver) device and writes 
+// resulting binaries as program bundles loadable with 
+// Context::buildProgramFromBundle()
+
+namespace {
+
+void printUsage(const char* name)
+{
+    std::cout << "Usage: " << name << " [options] <file.cl>...\n"
+        "Options:\n"
+        "  -o <file>          Output bundle (only with single input file)\n"
+        "  -p <index>         Use only platform with given index\n"
+        "  -t <cpu|gpu|all>   Device types to compile for (default: all)\n"
+        "  --offline          Compile for offline devices (AMD only)\n"
+        "  --options <opts>   Build options passed to the compiler\n"
+        "  -D<macro>, -I<dir>, -cl-<opt>, -w, -Werror\n"
+        "                     Appended to build options\n"
+        "  -h, --help         Print this message\n";
+}
+
+std::string bundleFileName(const std::string& sourceFile)
+{
+    const std::string::size_type sep = sourceFile.find_last_of("/\\");
+    const std::string::size_type dot = sourceFile.rfind('.');
+    if(dot == std::string::npos || (sep != std::string::npos && dot < sep))
+        return sourceFile + ".clwb";
+    return sourceFile.substr(0, dot) + ".clwb";
+}
+
+bool isBuildOption(const char* arg)
+{
+    return !std::strncmp(arg, "-D", 2) || !std::strncmp(arg, "-I", 2) ||
+        !std::strncmp(arg, "-cl-", 4) || !std::strcmp(arg, "-w") ||
+        !std::strcmp(arg, "-Werror");
+}
+
+struct Options
+{
+    Options() : platformIndex(-1), deviceTypes(clw::EDeviceType::All), 
+        offline(false) {}
+
+    std::vector<std::string> inputs;
+    std::string output;
+    std::string buildOptions;
+    int platformIndex;
+    clw::DeviceFlags deviceTypes;
+    bool offline;
+};
+
+// Returns false on malformed command line
+bool parseArguments(int argc, char* argv[], Options& opts)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if(!std::strcmp(arg, "-o") && hasValue)
+        {
+            opts.output = argv[++i];
+        }
+        else if(!std::strcmp(arg, "-p") && hasValue)
+        {
+            opts.platformIndex = std::atoi(argv[++i]);
+        }
+        else if(!std::strcmp(arg, "-t") && hasValue)
+        {
+            const std::string type = argv[++i];
+            if(type == "cpu")
+                opts.deviceTypes = clw::EDeviceType::Cpu;
+            else if(type == "gpu")
+                opts.deviceTypes = clw::EDeviceType::Gpu;
+            else if(type == "all")
+                opts.deviceTypes = clw::EDeviceType::All;
+            else
+                return false;
+        }
+        else if(!std::strcmp(arg, "--offline"))
+        {
+            opts.offline = true;
+        }
+        else if(!std::strcmp(arg, "--options") && hasValue)
+        {
+            if(!opts.buildOptions.empty())
+                opts.buildOptions += ' ';
+            opts.buildOptions += argv[++i];
+        }
+        else if(isBuildOption(arg))
+        {
+            if(!opts.buildOptions.empty())
+                opts.buildOptions += ' ';
+            opts.buildOptions += arg;
+        }
+        else if(arg[0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            opts.inputs.push_back(arg);
+        }
+    }
+
+    return !opts.inputs.empty() && 
+        (opts.output.empty() || opts.inputs.size() == 1);
+}
+
+// Creates one context per platform
+std::vector<std::unique_ptr<clw::Context>> createContexts(const Options& opts)
+{
+    std::vector<std::unique_ptr<clw::Context>> contexts;
+    const std::vector<clw::Platform> platforms = clw::availablePlatforms();
+
+    for(size_t i = 0; i < platforms.size(); ++i)
+    {
+        if(opts.platformIndex >= 0 && size_t(opts.platformIndex) != i)
+            continue;
+
+        std::unique_ptr<clw::Context> ctx(new clw::Context());
+        bool created;
+        if(opts.offline)
+        {
+            if(platforms[i].vendorEnum() != clw::EPlatformVendor::AMD)
+                continue;
+            created = ctx->createOffline(platforms[i]);
+        }
+        else
+        {
+            std::vector<clw::Device> devs = 
+                clw::devices(opts.deviceTypes, platforms[i]);
+            created = !devs.empty() && ctx->create(devs);
+        }
+
+        if(created && ctx->numDevices() > 0)
+            contexts.push_back(std::move(ctx));
+    }
+
+    return contexts;
+}
+
+bool compile(const std::vector<std::unique_ptr<clw::Context>>& contexts,
+             const std::string& input, const std::string& output, 
+             const std::string& buildOptions)
+{
+    clw::ProgramBundle bundle;
+    bundle.setBuildOptions(buildOptions);
+    bool success = true;
+
+    for(const auto& ctx : contexts)
+    {
+        clw::Program program = ctx->createProgramFromSourceFile(input);
+        if(program.isNull())
+        {
+            std::cerr << input << ": can't read source file\n";
+            return false;
+        }
+
+        const bool built = program.build(buildOptions);
+        const std::string log = program.log();
+        if(!log.empty())
+            std::cerr << input << ":\n" << log << '\n';
+        if(!built || !bundle.addProgram(program))
+        {
+            std::cerr << input << ": build failed for platform " 
+                      << ctx->devices()[0].platform().name() << '\n';
+            success = false;
+            continue;
+        }
+
+        for(const clw::Device& device : program.devices())
+            std::cout << input << ": " << device.name() << '\n';
+    }
+
+    if(!success || bundle.isEmpty())
+        return false;
+
+    if(!bundle.save(output))
+    {
+        std::cerr << output << ": can't write bundle\n";
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help"))
+        {
+            printUsage(argv[0]);
+            return EXIT_SUCCESS;
+        }
+    }
+
+    Options opts;
+    if(!parseArguments(argc, argv, opts))
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto contexts = createContexts(opts);
+    if(contexts.empty())
+    {
+        std::cerr << "No OpenCL device available\n";
+        return EXIT_FAILURE;
+    }
+
+    int result = EXIT_SUCCESS;
+    for(const std::string& input : opts.inputs)
+    {
+        const std::string output = opts.output.empty() ? 
+            bundleFileName(input) : opts.output;
+        if(!compile(contexts, input, output, opts.buildOptions))
+            result = EXIT_FAILURE;
+    }
+    return result;
+}